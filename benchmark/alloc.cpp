@@ -0,0 +1,380 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// counts heap allocations of detect() and track() into a HandResult over a recorded hand sequence
+//
+// yolox_alloc   [options] (--images <dir> | --nv21 <file> --size <w>x<h>)
+// nanodet_alloc [options] (--images <dir> | --nv21 <file> --size <w>x<h>)
+//
+//   --assets <dir>      model directory, app/src/main/assets of the app
+//   --frames <n>        replay at most n frames, default 100
+//   --interval <n>      redetect interval of the tracking pass, default 10
+//
+// frames are decoded up front, every pass runs the sequence once to grow the session scratch and
+// once counted. ncnn::Extractor allocates on every forward pass, its blob table and whatever layers
+// take outside the option allocators, so the counts are held against one forward pass of each net
+// measured on its own here. fails when a frame allocates anything beyond those forward passes
+//
+// glibc only, malloc and friends are replaced below
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "frames.h"
+#include "models.h"
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+static std::atomic<bool> g_counting(false);
+static std::atomic<int> g_allocs(0);
+
+static void count_alloc()
+{
+    if (g_counting)
+        g_allocs++;
+}
+
+// operator new and ncnn::fastMalloc end up in one of these
+extern "C" void* malloc(size_t size)
+{
+    count_alloc();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+    count_alloc();
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    count_alloc();
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size)
+{
+    count_alloc();
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size)
+{
+    count_alloc();
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    count_alloc();
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+extern "C" void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+
+static void start_counting()
+{
+    g_allocs = 0;
+    g_counting = true;
+}
+
+static int stop_counting()
+{
+    g_counting = false;
+    return g_allocs;
+}
+
+// allocations of one single threaded forward pass of net on a blank w x h input, arenas as the sessions use
+static int forward_allocs(const ncnn::Net& net, int w, int h, const char* input, const char* const* outputs, int output_count)
+{
+    ArenaAllocator blob_allocator;
+    LockedArenaAllocator workspace_allocator;
+
+    ncnn::Mat in(w, h, 3);
+    in.fill(0.f);
+
+    int allocs = 0;
+    for (int pass = 0; pass < 3; pass++)
+    {
+        // the last pass runs on grown arenas
+        if (pass == 2)
+            start_counting();
+
+        {
+            ncnn::Extractor ex = net.create_extractor();
+            ex.set_num_threads(1);
+            ex.set_blob_allocator(&blob_allocator);
+            ex.set_workspace_allocator(&workspace_allocator);
+
+            ex.input(input, in);
+
+            for (int i = 0; i < output_count; i++)
+            {
+                ncnn::Mat out;
+                ex.extract(outputs[i], out);
+            }
+        }
+
+        blob_allocator.reset();
+        workspace_allocator.reset();
+
+        if (pass == 2)
+            allocs = stop_counting();
+    }
+
+    return allocs;
+}
+
+// allocations of the detector forward pass on a img_w x img_h frame
+static int detector_allocs(const DetectorModel& model, int img_w, int img_h)
+{
+#if BENCH_NANODET
+    // every frame is letterboxed into target_size x target_size
+    (void)img_w;
+    (void)img_h;
+
+    static const char* const outputs[] = {
+        "cls_pred_stride_8", "dis_pred_stride_8", "cls_pred_stride_16", "dis_pred_stride_16", "cls_pred_stride_32", "dis_pred_stride_32"
+    };
+    return forward_allocs(model.nanodet, model.target_size, model.target_size, "input.1", outputs, 6);
+#else
+    // the letterbox of Yolox::detect, padded to a multiple of 32
+    int w = img_w;
+    int h = img_h;
+    if (w > h)
+    {
+        h = h * ((float)model.target_size / w);
+        w = model.target_size;
+    }
+    else
+    {
+        w = w * ((float)model.target_size / h);
+        h = model.target_size;
+    }
+
+    static const char* const outputs[] = {"output"};
+    return forward_allocs(model.yolox, (w + 31) / 32 * 32, (h + 31) / 32 * 32, "input", outputs, 1);
+#endif
+}
+
+static int landmark_allocs(const DetectorModel& model)
+{
+    static const char* const outputs[] = {"points", "score"};
+    return forward_allocs(model.landmark->landmark, 224, 224, "input", outputs, 2);
+}
+
+// allocs must be fixed plus per_hand for each of min_hands to max_hands landmark passes
+static bool allocs_match(int allocs, int fixed, int per_hand, int min_hands, int max_hands)
+{
+    const int rest = allocs - fixed;
+    if (rest < 0)
+        return false;
+
+    if (per_hand == 0)
+        return rest == 0;
+
+    return rest % per_hand == 0 && rest / per_hand >= min_hands && rest / per_hand <= max_hands;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [--assets dir] [--frames n] [--interval n] (--images dir | --nv21 file --size wxh)\n", argv0);
+}
+
+int main(int argc, char** argv)
+{
+    const char* assets = ".";
+    const char* images = 0;
+    const char* nv21 = 0;
+    int nv21_width = 0;
+    int nv21_height = 0;
+    int max_frames = 100;
+    int interval = 10;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char* arg = argv[i];
+        const char* value = argv[i + 1];
+
+        if (strcmp(arg, "--assets") == 0)
+        {
+            assets = value;
+        }
+        else if (strcmp(arg, "--frames") == 0)
+        {
+            max_frames = atoi(value);
+        }
+        else if (strcmp(arg, "--interval") == 0)
+        {
+            interval = atoi(value);
+        }
+        else if (strcmp(arg, "--images") == 0)
+        {
+            images = value;
+        }
+        else if (strcmp(arg, "--nv21") == 0)
+        {
+            nv21 = value;
+        }
+        else if (strcmp(arg, "--size") == 0)
+        {
+            sscanf(value, "%dx%d", &nv21_width, &nv21_height);
+        }
+        else
+        {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (argc % 2 == 0)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    FrameSource source;
+    int ret = -1;
+    if (images)
+    {
+        ret = source.open_images(images);
+    }
+    else if (nv21 && nv21_width > 0 && nv21_height > 0)
+    {
+        ret = source.open_nv21(nv21, nv21_width, nv21_height);
+    }
+    else
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    std::vector<cv::Mat> frames;
+    for (int i = 0; ret == 0 && i < source.count() && (int)frames.size() < max_frames; i++)
+    {
+        cv::Mat rgb;
+        if (source.read(i, rgb) == 0)
+            frames.push_back(rgb);
+    }
+
+    if (frames.empty())
+    {
+        fprintf(stderr, "no frames\n");
+        return -1;
+    }
+
+    // the detectors load their models and the landmark model from the working directory
+    if (chdir(assets) != 0)
+    {
+        fprintf(stderr, "chdir %s failed\n", assets);
+        return -1;
+    }
+
+    const ModelVariant& variant = model_variants[0];
+
+    std::shared_ptr<DetectorModel> detector_model = std::make_shared<DetectorModel>();
+    if (detector_model->load(variant.modeltype, variant.target_size, variant.mean_vals, variant.norm_vals) != 0)
+    {
+        fprintf(stderr, "load %s failed\n", variant.modeltype);
+        return -1;
+    }
+
+    // recorded sequences have one frame size
+    const int detector_cost = detector_allocs(*detector_model, frames[0].cols, frames[0].rows);
+    const int landmark_cost = landmark_allocs(*detector_model);
+
+    fprintf(stdout, "%s forward pass allocations: detector %d, landmark %d\n", variant.modeltype, detector_cost, landmark_cost);
+
+    int failed = 0;
+
+    // one thread, so openmp does not set up teams inside the counted frames
+    // pass 0 runs the detector on every frame, pass 1 tracks
+    for (int pass = 0; pass < 2; pass++)
+    {
+        Detector detector;
+        detector.set_model(detector_model);
+        detector.set_num_threads(1);
+        detector.set_tracking(0.8f, interval);
+
+        HandResult result;
+        int previous_count = 0;
+        int total_allocs = 0;
+        int extra_frames = 0;
+
+        for (int round = 0; round < 2; round++)
+        {
+            const bool counted = round == 1;
+
+            for (size_t i = 0; i < frames.size(); i++)
+            {
+                const bool redetect = pass == 0 || detector.need_detect();
+
+                start_counting();
+                if (pass == 0)
+                    detector.detect(frames[i], result);
+                else
+                    detector.track(frames[i], result);
+                const int allocs = stop_counting();
+
+                if (counted)
+                {
+                    // detected frames run the landmark net on every box, tracked frames on at most the hands of the previous frame
+                    const int min_hands = redetect ? result.count : 0;
+                    int max_hands = redetect ? result.count : previous_count;
+
+                    // a full result may have been cut off at HandResult::max_hands
+                    if (max_hands == HandResult::max_hands)
+                        max_hands = INT_MAX;
+
+                    if (!allocs_match(allocs, redetect ? detector_cost : 0, landmark_cost, min_hands, max_hands))
+                    {
+                        fprintf(stderr, "%s frame %d: %d allocations, %d hands%s\n", pass == 0 ? "detect" : "track", (int)i, allocs, result.count, redetect ? " detected" : "");
+                        extra_frames++;
+                    }
+
+                    total_allocs += allocs;
+                }
+
+                previous_count = result.count;
+            }
+        }
+
+        fprintf(stdout, "%s: %d frames, %d allocations, %d frames allocating beyond the extractors\n",
+                pass == 0 ? "detect" : "track", (int)frames.size(), total_allocs, extra_frames);
+
+        failed += extra_frames;
+    }
+
+    return failed == 0 ? 0 : 1;
+}
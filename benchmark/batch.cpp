@@ -0,0 +1,294 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// offline hand annotation of recorded sessions
+//
+// yolox_batch   [options] (--images <dir> | --nv21 <file> --size <w>x<h>)
+// nanodet_batch [options] (--images <dir> | --nv21 <file> --size <w>x<h>)
+//
+//   --assets <dir>      model directory, app/src/main/assets of the app
+//   --model <name>      model variant, the first one by default
+//   --workers <n>       worker threads, cpu count by default
+//   --output <file>     jsonl output, stdout by default
+//
+// one json line per frame, in frame order
+// {"frame":0,"name":"0001.jpg","hands":[{"label":0,"prob":0.91,"box":[x,y,w,h],"points":[x0,y0,..,x20,y20]}]}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "benchmark.h"
+#include "cpu.h"
+
+#include "frames.h"
+#include "models.h"
+
+// frames finish out of order on the workers, lines are written in frame order
+class OrderedWriter
+{
+public:
+    OrderedWriter(FILE* _fp, int count)
+        : fp(_fp), lines(count), done(count, 0), next(0)
+    {
+    }
+
+    void write(int i, std::string& line)
+    {
+        std::lock_guard<std::mutex> g(mutex);
+
+        lines[i].swap(line);
+        done[i] = 1;
+
+        while (next < (int)done.size() && done[next])
+        {
+            fwrite(lines[next].data(), 1, lines[next].size(), fp);
+            std::string().swap(lines[next]);
+            next++;
+        }
+    }
+
+private:
+    FILE* fp;
+    std::mutex mutex;
+    std::vector<std::string> lines;
+    std::vector<char> done;
+    int next;
+};
+
+static void format_frame(int i, const std::string& name, const std::vector<Object>& objects, std::string& line)
+{
+    char buf[64];
+
+    sprintf(buf, "{\"frame\":%d,\"name\":\"", i);
+    line = buf;
+    for (size_t j = 0; j < name.size(); j++)
+    {
+        if (name[j] == '"' || name[j] == '\\')
+            line += '\\';
+        line += name[j];
+    }
+    line += "\",\"hands\":[";
+
+    for (size_t j = 0; j < objects.size(); j++)
+    {
+        const Object& obj = objects[j];
+
+        sprintf(buf, "%s{\"label\":%d,\"prob\":%.3f,\"box\":[", j == 0 ? "" : ",", obj.label, obj.prob);
+        line += buf;
+        sprintf(buf, "%.1f,%.1f,%.1f,%.1f],\"points\":[", obj.rect.x, obj.rect.y, obj.rect.width, obj.rect.height);
+        line += buf;
+
+        for (int k = 0; k < 21; k++)
+        {
+            sprintf(buf, "%s%.1f,%.1f", k == 0 ? "" : ",", obj.pts[k].x, obj.pts[k].y);
+            line += buf;
+        }
+
+        line += "]}";
+    }
+
+    line += "]}\n";
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [--assets dir] [--model name] [--workers n] [--output file] (--images dir | --nv21 file --size wxh)\n", argv0);
+}
+
+int main(int argc, char** argv)
+{
+    const char* assets = ".";
+    const char* model = 0;
+    const char* images = 0;
+    const char* nv21 = 0;
+    const char* output = 0;
+    int nv21_width = 0;
+    int nv21_height = 0;
+    int num_workers = ncnn::get_cpu_count();
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char* arg = argv[i];
+        const char* value = argv[i + 1];
+
+        if (strcmp(arg, "--assets") == 0)
+        {
+            assets = value;
+        }
+        else if (strcmp(arg, "--model") == 0)
+        {
+            model = value;
+        }
+        else if (strcmp(arg, "--workers") == 0)
+        {
+            num_workers = atoi(value);
+        }
+        else if (strcmp(arg, "--output") == 0)
+        {
+            output = value;
+        }
+        else if (strcmp(arg, "--images") == 0)
+        {
+            images = value;
+        }
+        else if (strcmp(arg, "--nv21") == 0)
+        {
+            nv21 = value;
+        }
+        else if (strcmp(arg, "--size") == 0)
+        {
+            sscanf(value, "%dx%d", &nv21_width, &nv21_height);
+        }
+        else
+        {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (argc % 2 == 0 || num_workers < 1)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    const ModelVariant* variant = &model_variants[0];
+    if (model)
+    {
+        variant = 0;
+        for (int i = 0; i < model_variant_count; i++)
+        {
+            if (strcmp(model, model_variants[i].modeltype) == 0)
+                variant = &model_variants[i];
+        }
+
+        if (!variant)
+        {
+            fprintf(stderr, "unknown model %s\n", model);
+            return -1;
+        }
+    }
+
+    FrameSource source;
+    int ret = -1;
+    if (images)
+    {
+        ret = source.open_images(images);
+    }
+    else if (nv21 && nv21_width > 0 && nv21_height > 0)
+    {
+        ret = source.open_nv21(nv21, nv21_width, nv21_height);
+    }
+    else
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (ret != 0)
+        return -1;
+
+    FILE* fp = output ? fopen(output, "wb") : stdout;
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", output);
+        return -1;
+    }
+
+    // the detectors load their models and the landmark model from the working directory
+    if (chdir(assets) != 0)
+    {
+        fprintf(stderr, "chdir %s failed\n", assets);
+        return -1;
+    }
+
+    const int count = source.count();
+
+    OrderedWriter writer(fp, count);
+    std::atomic<int> next_frame(0);
+    std::atomic<int> failed(0);
+
+    double start = ncnn::get_current_time();
+
+    // nets and weights are loaded once and shared by every worker
+    std::shared_ptr<DetectorModel> detector_model = std::make_shared<DetectorModel>();
+    if (detector_model->load(variant->modeltype, variant->target_size, variant->mean_vals, variant->norm_vals) != 0)
+    {
+        fprintf(stderr, "load %s failed\n", variant->modeltype);
+        return -1;
+    }
+
+    // every worker runs its own single threaded session with its own extractors and allocator pair
+    // frames are handed out one at a time so slow frames do not hold up a whole shard
+    // detect() on every frame, track() would carry state across frames that land on different workers
+    std::vector<std::thread> workers;
+    for (int w = 0; w < num_workers; w++)
+    {
+        workers.push_back(std::thread([&]() {
+            Detector detector;
+            detector.set_model(detector_model);
+            detector.set_num_threads(1);
+
+            cv::Mat rgb;
+            std::vector<Object> objects;
+            std::string line;
+
+            for (;;)
+            {
+                int i = next_frame.fetch_add(1);
+                if (i >= count)
+                    break;
+
+                objects.clear();
+                if (source.read(i, rgb) == 0)
+                {
+                    detector.detect(rgb, objects);
+                }
+                else
+                {
+                    failed++;
+                }
+
+                format_frame(i, source.name(i), objects, line);
+                writer.write(i, line);
+            }
+        }));
+    }
+
+    for (size_t w = 0; w < workers.size(); w++)
+    {
+        workers[w].join();
+    }
+
+    double elapsed = ncnn::get_current_time() - start;
+
+    if (fp != stdout)
+        fclose(fp);
+
+    fprintf(stderr, "%s %d frames, %d unreadable, %d workers, %.2fs, %.2f fps\n", variant->modeltype, count, failed.load(), num_workers, elapsed / 1000, count * 1000.0 / elapsed);
+
+    return 0;
+}
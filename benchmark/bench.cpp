@@ -0,0 +1,377 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// host benchmark of the detector and landmark cores
+//
+// yolox_bench   [options] (--images <dir> | --nv21 <file> --size <w>x<h>)
+// nanodet_bench [options] (--images <dir> | --nv21 <file> --size <w>x<h>)
+//
+//   --assets <dir>      model directory, app/src/main/assets of the app
+//   --model <name>      only this model variant, all variants by default
+//   --threads <n,n,..>  thread counts to run, big core count by default
+//   --loops <n>         passes over the frames, default 10
+//   --track             run track() instead of detect() every frame
+//   --cold              load time, resident memory and first frame latency of a fresh process,
+//                       mapped and copied weights, with and without warmup()
+//   --trace <file>      write a chrome trace json of all runs
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "benchmark.h"
+#include "cpu.h"
+
+#include "profiler.h"
+#include "tracer.h"
+
+#include "modelfile.h"
+
+#include "frames.h"
+#include "models.h"
+
+static float percentile(const std::vector<float>& sorted, int p)
+{
+    // nearest rank
+    int i = ((int)sorted.size() * p + 99) / 100 - 1;
+    return sorted[std::min(std::max(i, 0), (int)sorted.size() - 1)];
+}
+
+static long peak_rss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// kB of a /proc/self/status field, VmRSS counts all resident pages, RssAnon leaves out file pages such as mapped weights
+static long status_kb(const char* field)
+{
+    FILE* fp = fopen("/proc/self/status", "rb");
+    if (!fp)
+        return -1;
+
+    const size_t len = strlen(field);
+
+    long kb = -1;
+    char line[256];
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (strncmp(line, field, len) == 0 && line[len] == ':')
+        {
+            kb = atol(line + len + 1);
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    return kb;
+}
+
+// load in a forked child, so every measurement starts from the same heap and none inherits a loaded net
+// the model files stay in the page cache after the first load, drop caches before a run for a disk cold start
+static void cold_start(const ModelVariant& variant, int num_threads, bool mapped, bool warmup, const cv::Mat& frame)
+{
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "fork failed\n");
+        return;
+    }
+
+    if (pid > 0)
+    {
+        int status;
+        waitpid(pid, &status, 0);
+        return;
+    }
+
+    set_weight_mapping(mapped);
+
+    const long rss0 = status_kb("VmRSS");
+    const long anon0 = status_kb("RssAnon");
+
+    double t0 = ncnn::get_current_time();
+
+    Detector detector;
+    if (detector.load(variant.modeltype, variant.target_size, variant.mean_vals, variant.norm_vals) != 0)
+    {
+        fprintf(stderr, "load %s failed\n", variant.modeltype);
+        _exit(1);
+    }
+    detector.set_num_threads(num_threads);
+
+    double load_time = ncnn::get_current_time() - t0;
+
+    const long rss1 = status_kb("VmRSS");
+    const long anon1 = status_kb("RssAnon");
+
+    double warmup_time = warmup ? detector.warmup() : 0.0;
+
+    // the frame the camera opens with, then one in steady state for reference
+    std::vector<Object> objects;
+
+    t0 = ncnn::get_current_time();
+    detector.detect(frame, objects);
+    double first_time = ncnn::get_current_time() - t0;
+
+    t0 = ncnn::get_current_time();
+    detector.detect(frame, objects);
+    double second_time = ncnn::get_current_time() - t0;
+
+    fprintf(stdout, "%s threads=%d weights=%s load=%.2fms rss=+%ldKB anon=+%ldKB warmup=%s%.2fms first=%.2fms second=%.2fms\n",
+            variant.modeltype, num_threads, mapped ? "mapped" : "copied", load_time, rss1 - rss0, anon1 - anon0,
+            warmup ? "" : "off ", warmup_time, first_time, second_time);
+    fflush(stdout);
+
+    _exit(0);
+}
+
+static void run(const ModelVariant& variant, int num_threads, const std::vector<cv::Mat>& frames, int loops, bool track)
+{
+    Detector detector;
+    if (detector.load(variant.modeltype, variant.target_size, variant.mean_vals, variant.norm_vals) != 0)
+    {
+        fprintf(stderr, "load %s failed\n", variant.modeltype);
+        return;
+    }
+    detector.set_num_threads(num_threads);
+
+    double warmup_time = detector.warmup();
+
+    StageProfiler::reset();
+
+    std::vector<float> latency;
+    latency.reserve(frames.size() * loops);
+
+    std::vector<Object> objects;
+
+    double start = ncnn::get_current_time();
+    for (int i = 0; i < loops; i++)
+    {
+        for (size_t j = 0; j < frames.size(); j++)
+        {
+            TRACE_FRAME(i * (int)frames.size() + (int)j);
+
+            double t0 = ncnn::get_current_time();
+
+            if (track)
+                detector.track(frames[j], objects);
+            else
+                detector.detect(frames[j], objects);
+
+            latency.push_back((float)(ncnn::get_current_time() - t0));
+        }
+    }
+    double total = ncnn::get_current_time() - start;
+
+    std::sort(latency.begin(), latency.end());
+
+    fprintf(stdout, "%s threads=%d frames=%d warmup=%.2fms\n", variant.modeltype, num_threads, (int)latency.size(), warmup_time);
+    fprintf(stdout, "  %-12s p50=%8.2f p95=%8.2f p99=%8.2f ms\n", "end-to-end", percentile(latency, 50), percentile(latency, 95), percentile(latency, 99));
+
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        float p50;
+        float p95;
+        float p99;
+        if (StageProfiler::query(i, p50, p95, p99) == 0)
+            continue;
+
+        fprintf(stdout, "  %-12s p50=%8.2f p95=%8.2f p99=%8.2f ms\n", StageProfiler::name(i), p50, p95, p99);
+    }
+
+    size_t arena_current;
+    size_t arena_peak;
+    detector.get_arena_usage(arena_current, arena_peak);
+
+    fprintf(stdout, "  throughput %.2f fps, peak rss %ld KB, arena peak %ld KB\n", latency.size() * 1000.0 / total, peak_rss_kb(), (long)(arena_peak / 1024));
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [--assets dir] [--model name] [--threads n,n,..] [--loops n] [--track] [--cold] [--trace file] (--images dir | --nv21 file --size wxh)\n", argv0);
+}
+
+int main(int argc, char** argv)
+{
+    const char* assets = ".";
+    const char* model = 0;
+    const char* images = 0;
+    const char* nv21 = 0;
+    int nv21_width = 0;
+    int nv21_height = 0;
+    std::vector<int> thread_counts;
+    int loops = 10;
+    bool track = false;
+    bool cold = false;
+    const char* trace = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : 0;
+
+        if (strcmp(arg, "--track") == 0)
+        {
+            track = true;
+            continue;
+        }
+
+        if (strcmp(arg, "--cold") == 0)
+        {
+            cold = true;
+            continue;
+        }
+
+        if (!value)
+        {
+            usage(argv[0]);
+            return -1;
+        }
+        i++;
+
+        if (strcmp(arg, "--assets") == 0)
+        {
+            assets = value;
+        }
+        else if (strcmp(arg, "--model") == 0)
+        {
+            model = value;
+        }
+        else if (strcmp(arg, "--images") == 0)
+        {
+            images = value;
+        }
+        else if (strcmp(arg, "--nv21") == 0)
+        {
+            nv21 = value;
+        }
+        else if (strcmp(arg, "--size") == 0)
+        {
+            sscanf(value, "%dx%d", &nv21_width, &nv21_height);
+        }
+        else if (strcmp(arg, "--threads") == 0)
+        {
+            for (const char* p = value; p; p = strchr(p, ','))
+            {
+                if (*p == ',')
+                    p++;
+                thread_counts.push_back(atoi(p));
+            }
+        }
+        else if (strcmp(arg, "--loops") == 0)
+        {
+            loops = atoi(value);
+        }
+        else if (strcmp(arg, "--trace") == 0)
+        {
+            trace = value;
+        }
+        else
+        {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    FrameSource source;
+    if (images)
+    {
+        source.open_images(images);
+    }
+    else if (nv21 && nv21_width > 0 && nv21_height > 0)
+    {
+        source.open_nv21(nv21, nv21_width, nv21_height);
+    }
+    else
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    // decoded up front, the runs only time the detector
+    std::vector<cv::Mat> frames;
+    for (int i = 0; i < source.count(); i++)
+    {
+        cv::Mat rgb;
+        if (source.read(i, rgb) == 0)
+            frames.push_back(rgb);
+    }
+
+    if (frames.empty())
+    {
+        fprintf(stderr, "no frames\n");
+        return -1;
+    }
+
+    if (thread_counts.empty())
+        thread_counts.push_back(ncnn::get_big_cpu_count());
+
+    // resolve the trace path before leaving the working directory
+    std::string trace_path;
+    if (trace)
+    {
+        char cwd[4096];
+        trace_path = trace[0] == '/' || !getcwd(cwd, sizeof(cwd)) ? std::string(trace) : std::string(cwd) + "/" + trace;
+        Tracer::start();
+    }
+
+    // the detectors load their models and the landmark model from the working directory
+    if (chdir(assets) != 0)
+    {
+        fprintf(stderr, "chdir %s failed\n", assets);
+        return -1;
+    }
+
+    for (int i = 0; i < model_variant_count; i++)
+    {
+        if (model && strcmp(model, model_variants[i].modeltype) != 0)
+            continue;
+
+        for (size_t j = 0; j < thread_counts.size(); j++)
+        {
+            if (cold)
+            {
+                cold_start(model_variants[i], thread_counts[j], true, false, frames[0]);
+                cold_start(model_variants[i], thread_counts[j], true, true, frames[0]);
+                cold_start(model_variants[i], thread_counts[j], false, false, frames[0]);
+                continue;
+            }
+
+            run(model_variants[i], thread_counts[j], frames, loops, track);
+        }
+    }
+
+    if (trace)
+    {
+        Tracer::dump(trace_path.c_str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "frames.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dirent.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "nv21.h"
+
+FrameSource::FrameSource()
+{
+    nv21_fd = -1;
+    nv21_width = 0;
+    nv21_height = 0;
+    nv21_count = 0;
+}
+
+FrameSource::~FrameSource()
+{
+    if (nv21_fd != -1)
+        close(nv21_fd);
+}
+
+int FrameSource::open_images(const char* _dirpath)
+{
+    DIR* dir = opendir(_dirpath);
+    if (!dir)
+    {
+        fprintf(stderr, "opendir %s failed\n", _dirpath);
+        return -1;
+    }
+
+    // absolute, the tools change the working directory to load models
+    char path[PATH_MAX];
+    dirpath = realpath(_dirpath, path) ? path : _dirpath;
+    filenames.clear();
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != 0)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        filenames.push_back(entry->d_name);
+    }
+    closedir(dir);
+
+    std::sort(filenames.begin(), filenames.end());
+
+    return 0;
+}
+
+int FrameSource::open_nv21(const char* path, int width, int height)
+{
+    nv21_fd = open(path, O_RDONLY);
+    if (nv21_fd == -1)
+    {
+        fprintf(stderr, "open %s failed\n", path);
+        return -1;
+    }
+
+    struct stat st;
+    fstat(nv21_fd, &st);
+
+    nv21_width = width;
+    nv21_height = height;
+    nv21_count = (int)(st.st_size / (width * height * 3 / 2));
+
+    return 0;
+}
+
+int FrameSource::count() const
+{
+    return nv21_fd != -1 ? nv21_count : (int)filenames.size();
+}
+
+std::string FrameSource::name(int i) const
+{
+    if (nv21_fd == -1)
+        return filenames[i];
+
+    char index[16];
+    sprintf(index, "%d", i);
+    return index;
+}
+
+int FrameSource::read(int i, cv::Mat& rgb) const
+{
+    if (nv21_fd == -1)
+    {
+        cv::Mat bgr = cv::imread(dirpath + "/" + filenames[i], 1);
+        if (bgr.empty())
+            return -1;
+
+        cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+        return 0;
+    }
+
+    const size_t size = nv21_width * nv21_height * 3 / 2;
+
+    // one frame per thread, pread keeps the shared fd offset out of the way
+    std::vector<unsigned char> nv21(size);
+    if (pread(nv21_fd, nv21.data(), size, (off_t)size * i) != (ssize_t)size)
+        return -1;
+
+    rgb.create(nv21_height, nv21_width, CV_8UC3);
+    nv21_roi_rotate_to_rgb(nv21.data(), nv21_width, nv21_height, 0, 0, nv21_width, nv21_height, 1, rgb.data, (int)rgb.step[0]);
+
+    return 0;
+}
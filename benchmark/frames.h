@@ -0,0 +1,57 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// the frames of an image directory or of a raw dump of back to back nv21 frames
+// frames are decoded on demand, read() may run on several threads at once
+class FrameSource
+{
+public:
+    FrameSource();
+    ~FrameSource();
+
+    // every decodable image in the directory, in file name order
+    int open_images(const char* dirpath);
+
+    int open_nv21(const char* path, int width, int height);
+
+    int count() const;
+
+    // image file name, or the frame index of a nv21 dump
+    std::string name(int i) const;
+
+    // decode frame i to rgb
+    int read(int i, cv::Mat& rgb) const;
+
+private:
+    FrameSource(const FrameSource&);
+    FrameSource& operator=(const FrameSource&);
+
+    std::string dirpath;
+    std::vector<std::string> filenames;
+
+    int nv21_fd;
+    int nv21_width;
+    int nv21_height;
+    int nv21_count;
+};
+
+#endif // FRAMES_H
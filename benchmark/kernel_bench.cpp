@@ -0,0 +1,384 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// host microbenchmark of the pre and postprocess kernels against the code they replaced
+//
+// kernel_bench [--loops <n>]
+//
+//   --loops <n>   timed calls per case, default 2000
+//
+// each case prints old and new time per call in us and fails when the outputs differ
+// beyond the rounding the old code did
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "benchmark.h"
+#include "mat.h"
+
+#include "letterbox.h"
+#include "nms.h"
+
+static int g_loops = 2000;
+
+// keeps the timed results alive
+static volatile int g_sink = 0;
+
+static float random_uniform(float a, float b)
+{
+    return a + (b - a) * (rand() / (float)RAND_MAX);
+}
+
+// best of 5 rounds of g_loops calls, in us per call
+template<typename Func>
+static double time_us(const Func& func)
+{
+    double best = DBL_MAX;
+    for (int r = 0; r < 5; r++)
+    {
+        double start = ncnn::get_current_time();
+        for (int i = 0; i < g_loops; i++)
+        {
+            g_sink += func();
+        }
+        double end = ncnn::get_current_time();
+        best = std::min(best, (end - start) * 1000.0 / g_loops);
+    }
+    return best;
+}
+
+static void report(const char* name, double old_us, double new_us)
+{
+    printf("%-32s old %9.2f us  new %9.2f us  x%.2f\n", name, old_us, new_us, old_us / new_us);
+}
+
+struct Proposal
+{
+    cv::Rect_<float> rect;
+    float prob;
+};
+
+// the aos quicksort and nms loop both detectors used before BoxNms
+static void qsort_descent_inplace(std::vector<Proposal>& objects, int left, int right)
+{
+    int i = left;
+    int j = right;
+    float p = objects[(left + right) / 2].prob;
+
+    while (i <= j)
+    {
+        while (objects[i].prob > p)
+            i++;
+
+        while (objects[j].prob < p)
+            j--;
+
+        if (i <= j)
+        {
+            std::swap(objects[i], objects[j]);
+
+            i++;
+            j--;
+        }
+    }
+
+    if (left < j) qsort_descent_inplace(objects, left, j);
+    if (i < right) qsort_descent_inplace(objects, i, right);
+}
+
+static void nms_sorted_bboxes(const std::vector<Proposal>& objects, std::vector<int>& picked, float nms_threshold)
+{
+    picked.clear();
+
+    const int n = objects.size();
+
+    std::vector<float> areas(n);
+    for (int i = 0; i < n; i++)
+    {
+        areas[i] = objects[i].rect.area();
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        const Proposal& a = objects[i];
+
+        int keep = 1;
+        for (int j = 0; j < (int)picked.size(); j++)
+        {
+            const Proposal& b = objects[picked[j]];
+
+            float inter_area = (a.rect & b.rect).area();
+            float union_area = areas[i] + areas[picked[j]] - inter_area;
+            if (inter_area / union_area > nms_threshold)
+                keep = 0;
+        }
+
+        if (keep)
+            picked.push_back(i);
+    }
+}
+
+static void nms_old(const std::vector<Proposal>& proposals, std::vector<Proposal>& sorted, std::vector<int>& picked, float nms_threshold)
+{
+    sorted = proposals;
+    if (!sorted.empty())
+        qsort_descent_inplace(sorted, 0, (int)sorted.size() - 1);
+    nms_sorted_bboxes(sorted, picked, nms_threshold);
+}
+
+static void nms_new(const std::vector<Proposal>& proposals, BoxNms& nms, std::vector<int>& picked, float nms_threshold, int topk)
+{
+    nms.clear();
+    for (size_t i = 0; i < proposals.size(); i++)
+    {
+        const cv::Rect_<float>& rect = proposals[i].rect;
+        nms.push_back(rect.x, rect.y, rect.width, rect.height, proposals[i].prob);
+    }
+    nms.run(picked, nms_threshold, topk);
+}
+
+// proposals clustered around a few hands like a real head output, plus scattered false positives
+static void make_proposals(int count, std::vector<Proposal>& proposals)
+{
+    const int num_hands = 4;
+    cv::Rect_<float> hands[num_hands];
+    for (int h = 0; h < num_hands; h++)
+    {
+        float size = random_uniform(40.f, 160.f);
+        hands[h] = cv::Rect_<float>(random_uniform(0.f, 416.f - size), random_uniform(0.f, 416.f - size), size, size);
+    }
+
+    proposals.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        Proposal& p = proposals[i];
+        if (i % 8 == 7)
+        {
+            float size = random_uniform(8.f, 64.f);
+            p.rect = cv::Rect_<float>(random_uniform(0.f, 400.f), random_uniform(0.f, 400.f), size, size);
+        }
+        else
+        {
+            const cv::Rect_<float>& hand = hands[i % num_hands];
+            float jitter = hand.width * 0.15f;
+            p.rect.x = hand.x + random_uniform(-jitter, jitter);
+            p.rect.y = hand.y + random_uniform(-jitter, jitter);
+            p.rect.width = hand.width + random_uniform(-jitter, jitter);
+            p.rect.height = hand.height + random_uniform(-jitter, jitter);
+        }
+        p.prob = random_uniform(0.3f, 1.f);
+    }
+}
+
+static int bench_nms()
+{
+    const float nms_threshold = 0.45f;
+    const int counts[] = {10, 100, 1000};
+
+    int failed = 0;
+    for (int c = 0; c < 3; c++)
+    {
+        std::vector<Proposal> proposals;
+        make_proposals(counts[c], proposals);
+
+        std::vector<Proposal> sorted;
+        std::vector<int> picked_old;
+        BoxNms nms;
+        std::vector<int> picked_new;
+
+        // the same boxes must survive in the same order
+        nms_old(proposals, sorted, picked_old, nms_threshold);
+        nms_new(proposals, nms, picked_new, nms_threshold, -1);
+        bool same = picked_old.size() == picked_new.size();
+        for (size_t i = 0; same && i < picked_old.size(); i++)
+        {
+            const cv::Rect_<float>& a = sorted[picked_old[i]].rect;
+            const cv::Rect_<float>& b = proposals[picked_new[i]].rect;
+            same = a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+        }
+        if (!same)
+        {
+            fprintf(stderr, "nms %d picked %d boxes, BoxNms %d or a different set\n", counts[c], (int)picked_old.size(), (int)picked_new.size());
+            failed++;
+        }
+
+        char name[32];
+        sprintf(name, "nms %d proposals", counts[c]);
+        double old_us = time_us([&]() { nms_old(proposals, sorted, picked_old, nms_threshold); return (int)picked_old.size(); });
+        double new_us = time_us([&]() { nms_new(proposals, nms, picked_new, nms_threshold, -1); return (int)picked_new.size(); });
+        report(name, old_us, new_us);
+
+        if (counts[c] > 300)
+        {
+            // the detectors cap candidates at the top 300
+            sprintf(name, "nms %d proposals top300", counts[c]);
+            new_us = time_us([&]() { nms_new(proposals, nms, picked_new, nms_threshold, 300); return (int)picked_new.size(); });
+            report(name, old_us, new_us);
+        }
+    }
+
+    return failed;
+}
+
+struct LetterboxCase
+{
+    const char* name;
+    int img_w;
+    int img_h;
+    int target_size;
+    // nanodet centers the image and pads to a square of zeros in bgr, yolox pads right and bottom to 32 with 114
+    bool nanodet;
+};
+
+static int bench_letterbox()
+{
+    const LetterboxCase cases[] =
+    {
+        {"letterbox yolox 640x480", 640, 480, 416, false},
+        {"letterbox yolox 1280x720", 1280, 720, 416, false},
+        {"letterbox nanodet 640x480", 640, 480, 320, true},
+        {"letterbox nanodet 480x640", 480, 640, 320, true},
+    };
+
+    const float mean_vals[3] = {255.f * 0.485f, 255.f * 0.456f, 255.f * 0.406f};
+    const float norm_vals[3] = {1 / (255.f * 0.229f), 1 / (255.f * 0.224f), 1 / (255.f * 0.225f)};
+
+    int failed = 0;
+    for (int c = 0; c < (int)(sizeof(cases) / sizeof(cases[0])); c++)
+    {
+        const LetterboxCase& lc = cases[c];
+
+        // smooth gradients with noise, so interpolation differences show up
+        cv::Mat rgb(lc.img_h, lc.img_w, CV_8UC3);
+        for (int y = 0; y < lc.img_h; y++)
+        {
+            unsigned char* p = rgb.ptr<unsigned char>(y);
+            for (int x = 0; x < lc.img_w; x++)
+            {
+                p[x * 3 + 0] = (unsigned char)((x + y) / 8 + rand() % 32);
+                p[x * 3 + 1] = (unsigned char)(x * 255 / lc.img_w);
+                p[x * 3 + 2] = (unsigned char)(rand() % 256);
+            }
+        }
+
+        int w = lc.img_w;
+        int h = lc.img_h;
+        if (w > h)
+        {
+            h = h * lc.target_size / w;
+            w = lc.target_size;
+        }
+        else
+        {
+            w = w * lc.target_size / h;
+            h = lc.target_size;
+        }
+
+        int left = 0;
+        int top = 0;
+        int target_w = (w + 31) / 32 * 32;
+        int target_h = (h + 31) / 32 * 32;
+        float pad_value = 114.f;
+        if (lc.nanodet)
+        {
+            left = (lc.target_size - w) / 2;
+            top = (lc.target_size - h) / 2;
+            target_w = lc.target_size;
+            target_h = lc.target_size;
+            pad_value = 0.f;
+        }
+        const int pixel_type = lc.nanodet ? ncnn::Mat::PIXEL_RGB2BGR : ncnn::Mat::PIXEL_RGB;
+
+        // from_pixels_resize, copy_make_border and substract_mean_normalize, what the detectors ran before
+        ncnn::Mat in_pad_old;
+        auto letterbox_old = [&]() {
+            ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, pixel_type, lc.img_w, lc.img_h, (int)rgb.step[0], w, h);
+            ncnn::copy_make_border(in, in_pad_old, top, target_h - h - top, left, target_w - w - left, ncnn::BORDER_CONSTANT, pad_value);
+            in_pad_old.substract_mean_normalize(mean_vals, norm_vals);
+            return in_pad_old.w;
+        };
+
+        Letterbox letterbox;
+        ncnn::Mat in_pad_new;
+        auto letterbox_new = [&]() {
+            return letterbox.resize(rgb.data, lc.img_w, lc.img_h, (int)rgb.step[0], lc.nanodet, w, h, left, top, target_w, target_h, pad_value, mean_vals, norm_vals, in_pad_new);
+        };
+
+        letterbox_old();
+        if (letterbox_new() != 0 || in_pad_new.w != in_pad_old.w || in_pad_new.h != in_pad_old.h || in_pad_new.c != in_pad_old.c)
+        {
+            fprintf(stderr, "%s failed or shape differs\n", lc.name);
+            failed++;
+            continue;
+        }
+
+        // in 0-255 pixel units, ncnn rounds the resized pixels to 8 bit and Letterbox does not
+        float max_diff = 0.f;
+        double sum_diff = 0.0;
+        for (int q = 0; q < 3; q++)
+        {
+            const float* p0 = in_pad_old.channel(q);
+            const float* p1 = in_pad_new.channel(q);
+            for (int i = 0; i < target_w * target_h; i++)
+            {
+                float diff = fabsf(p0[i] - p1[i]) / norm_vals[q];
+                max_diff = std::max(max_diff, diff);
+                sum_diff += diff;
+            }
+        }
+
+        double old_us = time_us(letterbox_old);
+        double new_us = time_us(letterbox_new);
+        report(lc.name, old_us, new_us);
+        printf("%-32s max diff %.3f mean diff %.4f\n", "", max_diff, sum_diff / (target_w * target_h * 3));
+
+        // fixed point weights plus the 8 bit rounding stay within two levels
+        if (max_diff > 2.f)
+            failed++;
+    }
+
+    return failed;
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc)
+        {
+            g_loops = std::max(atoi(argv[++i]), 1);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--loops <n>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    srand(7);
+
+    int failed = 0;
+    failed += bench_nms();
+    failed += bench_letterbox();
+
+    return failed == 0 ? 0 : 1;
+}
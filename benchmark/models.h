@@ -0,0 +1,49 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef MODELS_H
+#define MODELS_H
+
+#if BENCH_NANODET
+#include "nanodet.h"
+typedef NanoDet Detector;
+typedef NanoDetModel DetectorModel;
+#else
+#include "yolox.h"
+typedef Yolox Detector;
+typedef YoloxModel DetectorModel;
+#endif
+
+struct ModelVariant
+{
+    const char* modeltype;
+    int target_size;
+    float mean_vals[3];
+    float norm_vals[3];
+};
+
+// the same table the jni loadModel uses
+static const ModelVariant model_variants[] =
+{
+#if BENCH_NANODET
+    {"hand", 320, {103.53f, 116.28f, 123.675f}, {1.f / 57.375f, 1.f / 57.12f, 1.f / 58.395f}},
+#else
+    {"yolox_hand_relu", 416, {255.f * 0.485f, 255.f * 0.456f, 255.f * 0.406f}, {1 / (255.f * 0.229f), 1 / (255.f * 0.224f), 1 / (255.f * 0.225f)}},
+    {"yolox_hand_swish", 416, {255.f * 0.485f, 255.f * 0.456f, 255.f * 0.406f}, {1 / (255.f * 0.229f), 1 / (255.f * 0.224f), 1 / (255.f * 0.225f)}},
+#endif
+};
+
+static const int model_variant_count = sizeof(model_variants) / sizeof(model_variants[0]);
+
+#endif // MODELS_H
@@ -0,0 +1,218 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// replays a recorded hand sequence through track() next to detect() on every frame
+//
+// yolox_replay   [options] (--images <dir> | --nv21 <file> --size <w>x<h>)
+// nanodet_replay [options] (--images <dir> | --nv21 <file> --size <w>x<h>)
+//
+//   --assets <dir>      model directory, app/src/main/assets of the app
+//   --interval <n>      redetect interval of the tracking session, default 10
+//   --min-match <f>     fraction of tracked hands that must overlap a detected hand, default 0.9
+//
+// fails when tracked hands drift away from the detector, or when a tracked hand reports
+// anything but the detector score of its last detection as prob
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "frames.h"
+#include "models.h"
+
+static float iou(const cv::Rect_<float>& a, const cv::Rect_<float>& b)
+{
+    float inter = (a & b).area();
+    float uni = a.area() + b.area() - inter;
+    return uni > 0.f ? inter / uni : 0.f;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [--assets dir] [--interval n] [--min-match f] (--images dir | --nv21 file --size wxh)\n", argv0);
+}
+
+int main(int argc, char** argv)
+{
+    const char* assets = ".";
+    const char* images = 0;
+    const char* nv21 = 0;
+    int nv21_width = 0;
+    int nv21_height = 0;
+    int interval = 10;
+    float min_match = 0.9f;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char* arg = argv[i];
+        const char* value = argv[i + 1];
+
+        if (strcmp(arg, "--assets") == 0)
+        {
+            assets = value;
+        }
+        else if (strcmp(arg, "--interval") == 0)
+        {
+            interval = atoi(value);
+        }
+        else if (strcmp(arg, "--min-match") == 0)
+        {
+            min_match = (float)atof(value);
+        }
+        else if (strcmp(arg, "--images") == 0)
+        {
+            images = value;
+        }
+        else if (strcmp(arg, "--nv21") == 0)
+        {
+            nv21 = value;
+        }
+        else if (strcmp(arg, "--size") == 0)
+        {
+            sscanf(value, "%dx%d", &nv21_width, &nv21_height);
+        }
+        else
+        {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (argc % 2 == 0)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    FrameSource source;
+    int ret = -1;
+    if (images)
+    {
+        ret = source.open_images(images);
+    }
+    else if (nv21 && nv21_width > 0 && nv21_height > 0)
+    {
+        ret = source.open_nv21(nv21, nv21_width, nv21_height);
+    }
+    else
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (ret != 0 || source.count() == 0)
+    {
+        fprintf(stderr, "no frames\n");
+        return -1;
+    }
+
+    // the detectors load their models and the landmark model from the working directory
+    if (chdir(assets) != 0)
+    {
+        fprintf(stderr, "chdir %s failed\n", assets);
+        return -1;
+    }
+
+    const ModelVariant& variant = model_variants[0];
+
+    std::shared_ptr<DetectorModel> detector_model = std::make_shared<DetectorModel>();
+    if (detector_model->load(variant.modeltype, variant.target_size, variant.mean_vals, variant.norm_vals) != 0)
+    {
+        fprintf(stderr, "load %s failed\n", variant.modeltype);
+        return -1;
+    }
+
+    // the reference runs the detector on every frame, the other session tracks
+    Detector reference;
+    reference.set_model(detector_model);
+
+    Detector tracking;
+    tracking.set_model(detector_model);
+    tracking.set_tracking(0.8f, interval);
+
+    cv::Mat rgb;
+    std::vector<Object> detected;
+    std::vector<Object> tracked;
+    std::vector<float> detector_probs;
+
+    int frames = 0;
+    int tracked_frames = 0;
+    int tracked_hands = 0;
+    int matched_hands = 0;
+    int bad_probs = 0;
+    double iou_sum = 0.0;
+
+    for (int i = 0; i < source.count(); i++)
+    {
+        if (source.read(i, rgb) != 0)
+            continue;
+
+        frames++;
+
+        reference.detect(rgb, detected);
+
+        const bool redetect = tracking.need_detect();
+        tracking.track(rgb, tracked);
+
+        if (redetect)
+        {
+            // the scores a tracked hand may carry until the next detector run
+            detector_probs.clear();
+            for (size_t j = 0; j < tracked.size(); j++)
+            {
+                detector_probs.push_back(tracked[j].prob);
+            }
+            continue;
+        }
+
+        tracked_frames++;
+
+        for (size_t j = 0; j < tracked.size(); j++)
+        {
+            const Object& obj = tracked[j];
+            tracked_hands++;
+
+            if (std::find(detector_probs.begin(), detector_probs.end(), obj.prob) == detector_probs.end())
+            {
+                fprintf(stderr, "frame %d: tracked hand prob %.3f is not a detector score\n", i, obj.prob);
+                bad_probs++;
+            }
+
+            float best = 0.f;
+            for (size_t k = 0; k < detected.size(); k++)
+            {
+                best = std::max(best, iou(obj.rect, detected[k].rect));
+            }
+
+            iou_sum += best;
+            if (best >= 0.3f)
+                matched_hands++;
+        }
+    }
+
+    const float match = tracked_hands > 0 ? (float)matched_hands / tracked_hands : 1.f;
+
+    fprintf(stdout, "%s %d frames, %d tracked frames, %d tracked hands, %.1f%% matched, mean iou %.3f, %d bad probs\n",
+            variant.modeltype, frames, tracked_frames, tracked_hands, match * 100, tracked_hands > 0 ? iou_sum / tracked_hands : 0.0, bad_probs);
+
+    return bad_probs == 0 && match >= min_match ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// ArenaAllocator frames: blocks never overlap, counters return to zero and reset() merges the chunks
+// LockedArenaAllocator the same with several threads allocating at once, as layers do with workspace
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+
+static int g_failed = 0;
+
+#define CHECK(cond)                                                    \
+    do                                                                 \
+    {                                                                  \
+        if (!(cond))                                                   \
+        {                                                              \
+            fprintf(stderr, "%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failed++;                                                \
+        }                                                              \
+    } while (0)
+
+// allocate blocks of random sizes, fill each with its own byte, free them all after checking nothing got overwritten
+static int run_frame(ncnn::Allocator* allocator, unsigned int seed, int count, size_t max_size)
+{
+    std::vector<unsigned char*> blocks(count);
+    std::vector<size_t> sizes(count);
+
+    int corrupted = 0;
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        sizes[i] = 1 + (seed >> 8) % max_size;
+        blocks[i] = (unsigned char*)allocator->fastMalloc(sizes[i]);
+        if (!blocks[i])
+        {
+            corrupted++;
+            continue;
+        }
+
+        memset(blocks[i], i & 0xff, sizes[i]);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!blocks[i])
+            continue;
+
+        for (size_t j = 0; j < sizes[i]; j += 61)
+        {
+            if (blocks[i][j] != (i & 0xff))
+            {
+                corrupted++;
+                break;
+            }
+        }
+
+        allocator->fastFree(blocks[i]);
+    }
+
+    return corrupted;
+}
+
+static void test_unlocked()
+{
+    ArenaAllocator arena;
+
+    for (int frame = 0; frame < 20; frame++)
+    {
+        CHECK(run_frame(&arena, frame, 50, 200000) == 0);
+        CHECK(arena.current_bytes() == 0);
+
+        arena.reset();
+    }
+
+    // the first frames grew several chunks, reset merged them and later frames fit
+    const size_t reserved = arena.reserved_bytes();
+    CHECK(run_frame(&arena, 3, 50, 200000) == 0);
+    arena.reset();
+    CHECK(arena.reserved_bytes() == reserved);
+
+    // a block still out keeps reset() from touching the arena
+    void* block = arena.fastMalloc(1000);
+    arena.reset();
+    CHECK(arena.current_bytes() > 0);
+    arena.fastFree(block);
+    CHECK(arena.current_bytes() == 0);
+}
+
+static void test_locked()
+{
+    LockedArenaAllocator arena;
+
+    for (int frame = 0; frame < 20; frame++)
+    {
+        // one extractor frame, its layers allocating small workspace blocks from four threads at once
+        std::atomic<int> ready(0);
+        std::vector<int> corrupted(4, 0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.push_back(std::thread([&arena, &ready, &corrupted, frame, t]()
+            {
+                ready++;
+                while (ready < 4)
+                {
+                    std::this_thread::yield();
+                }
+
+                for (int k = 0; k < 500; k++)
+                {
+                    corrupted[t] += run_frame(&arena, frame * 131 + t * 17 + k, 8, 4096);
+                }
+            }));
+        }
+
+        for (int t = 0; t < 4; t++)
+        {
+            threads[t].join();
+            CHECK(corrupted[t] == 0);
+        }
+
+        CHECK(arena.current_bytes() == 0);
+
+        arena.reset();
+    }
+
+    CHECK(arena.peak_bytes() > 0);
+}
+
+int main()
+{
+    test_unlocked();
+    test_locked();
+
+    printf("%d checks failed\n", g_failed);
+
+    return g_failed == 0 ? 0 : 1;
+}
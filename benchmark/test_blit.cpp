@@ -0,0 +1,102 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// rgb_rotate_to_rgba against kanna_rotate_c3 + the rgb to rgba row loop it replaced
+// all 8 rotate types, sizes around the simd widths and the 16x16 tiles, padded source and window strides
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "mat.h"
+
+#include "blit.h"
+
+// the render path before rgb_rotate_to_rgba
+static void blit_reference(const unsigned char* rgb, int w, int h, int stride, unsigned char* rgba, int outw, int outh, int outstride, int rotate_type)
+{
+    std::vector<unsigned char> rotated(outw * outh * 3);
+    ncnn::kanna_rotate_c3(rgb, w, h, stride, &rotated[0], outw, outh, outw * 3, rotate_type);
+
+    for (int y = 0; y < outh; y++)
+    {
+        const unsigned char* ptr = &rotated[y * outw * 3];
+        unsigned char* outptr = rgba + outstride * y;
+        for (int x = 0; x < outw; x++)
+        {
+            outptr[0] = ptr[0];
+            outptr[1] = ptr[1];
+            outptr[2] = ptr[2];
+            outptr[3] = 255;
+
+            ptr += 3;
+            outptr += 4;
+        }
+    }
+}
+
+int main()
+{
+    const int sizes[][2] = {{1, 1}, {7, 5}, {8, 8}, {16, 16}, {17, 15}, {33, 40}, {64, 48}, {100, 37}};
+
+    int failed = 0;
+    int cases = 0;
+    for (int si = 0; si < 8; si++)
+    {
+        const int w = sizes[si][0];
+        const int h = sizes[si][1];
+
+        // a cropped camera frame, rows wider than the roi
+        const int stride = w * 3 + 9;
+        std::vector<unsigned char> rgb(stride * h);
+        for (size_t i = 0; i < rgb.size(); i++)
+        {
+            rgb[i] = (unsigned char)(rand() % 256);
+        }
+
+        for (int rotate_type = 1; rotate_type <= 8; rotate_type++)
+        {
+            const int outw = rotate_type <= 4 ? w : h;
+            const int outh = rotate_type <= 4 ? h : w;
+
+            // window buffers are padded to a stride in pixels, the padding must stay untouched
+            const int outstride = (outw + 5) * 4;
+            std::vector<unsigned char> expected(outstride * outh, 0xa5);
+            std::vector<unsigned char> rgba(outstride * outh, 0xa5);
+
+            blit_reference(&rgb[0], w, h, stride, &expected[0], outw, outh, outstride, rotate_type);
+            rgb_rotate_to_rgba(&rgb[0], w, h, stride, &rgba[0], outw, outh, outstride, rotate_type);
+
+            cases++;
+            if (rgba != expected)
+            {
+                int mismatch = 0;
+                for (size_t i = 0; i < rgba.size(); i++)
+                {
+                    if (rgba[i] != expected[i])
+                        mismatch++;
+                }
+
+                fprintf(stderr, "%dx%d rotate %d: %d bytes differ\n", w, h, rotate_type, mismatch);
+                failed++;
+            }
+        }
+    }
+
+    printf("%d of %d cases differ\n", failed, cases);
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// DFLDecoder against the ncnn Softmax layer generate_proposals ran on every candidate before it,
+// and against rows whose expectation is known without any softmax
+// build on an arm64 host to cover the neon path
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "layer.h"
+#include "mat.h"
+
+#include "dfl.h"
+
+// the baseline decode, softmax over each ltrb row with the ncnn layer then the expectation
+static int decode_reference(const float* dis_pred, int reg_max_1, float* pred_ltrb)
+{
+    std::vector<float> rows(dis_pred, dis_pred + 4 * reg_max_1);
+    ncnn::Mat bbox_pred(reg_max_1, 4, (void*)&rows[0]);
+
+    ncnn::Layer* softmax = ncnn::create_layer("Softmax");
+    if (!softmax)
+        return -1;
+
+    ncnn::ParamDict pd;
+    pd.set(0, 1); // axis
+    pd.set(1, 1);
+    softmax->load_param(pd);
+
+    ncnn::Option opt;
+    opt.num_threads = 1;
+    opt.use_packing_layout = false;
+
+    softmax->create_pipeline(opt);
+
+    int ret = softmax->forward_inplace(bbox_pred, opt);
+
+    softmax->destroy_pipeline(opt);
+
+    delete softmax;
+
+    for (int k = 0; k < 4; k++)
+    {
+        float dis = 0.f;
+        const float* dis_after_sm = bbox_pred.row(k);
+        for (int l = 0; l < reg_max_1; l++)
+        {
+            dis += l * dis_after_sm[l];
+        }
+
+        pred_ltrb[k] = dis;
+    }
+
+    return ret;
+}
+
+// flat rows land in the middle bin, a saturated peak on its bin and two equal peaks halfway between them
+static int test_fixture()
+{
+    const int reg_max_1 = 8;
+
+    DFLDecoder decoder;
+    if (decoder.create(reg_max_1) != 0)
+        return 1;
+
+    float dis_pred[4 * reg_max_1];
+    for (int i = 0; i < 4 * reg_max_1; i++)
+    {
+        dis_pred[i] = 0.f;
+    }
+
+    // l flat, t peak on bin 0, r peak on bin 7, b peaks on bins 2 and 5
+    dis_pred[1 * reg_max_1 + 0] = 60.f;
+    dis_pred[2 * reg_max_1 + 7] = 60.f;
+    dis_pred[3 * reg_max_1 + 2] = 60.f;
+    dis_pred[3 * reg_max_1 + 5] = 60.f;
+
+    const float expected[4] = {3.5f, 0.f, 7.f, 3.5f};
+
+    float ltrb[4];
+    decoder.decode(dis_pred, ltrb);
+
+    int failed = 0;
+    for (int k = 0; k < 4; k++)
+    {
+        if (!(fabsf(ltrb[k] - expected[k]) <= 1e-4f))
+        {
+            fprintf(stderr, "fixture side %d decoded %g, expected %g\n", k, ltrb[k], expected[k]);
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+static float random_logit(float range)
+{
+    return (rand() / (float)RAND_MAX * 2.f - 1.f) * range;
+}
+
+int main()
+{
+    srand(7);
+
+    // nanodet-m bins, a wider head and the upper limit
+    const int bins[] = {8, 17, 32};
+    // soft, typical and saturated logits
+    const float ranges[] = {0.5f, 8.f, 60.f};
+
+    int failed = test_fixture();
+    for (int b = 0; b < 3; b++)
+    {
+        DFLDecoder decoder;
+        if (decoder.create(bins[b]) != 0)
+        {
+            fprintf(stderr, "create %d failed\n", bins[b]);
+            return 1;
+        }
+
+        for (int r = 0; r < 3; r++)
+        {
+            float max_diff = 0.f;
+            std::vector<float> dis_pred(4 * bins[b]);
+            for (int i = 0; i < 10000; i++)
+            {
+                for (size_t j = 0; j < dis_pred.size(); j++)
+                {
+                    dis_pred[j] = random_logit(ranges[r]);
+                }
+
+                float ltrb[4];
+                float expected[4];
+                decoder.decode(&dis_pred[0], ltrb);
+                if (decode_reference(&dis_pred[0], bins[b], expected) != 0)
+                {
+                    fprintf(stderr, "ncnn Softmax failed\n");
+                    return 1;
+                }
+
+                for (int k = 0; k < 4; k++)
+                {
+                    max_diff = std::max(max_diff, fabsf(ltrb[k] - expected[k]));
+                }
+            }
+
+            // the neon reciprocal is two newton steps from vrecpe, a few ulp of the bin count
+            const float tolerance = 1e-4f * bins[b];
+            printf("bins %2d logits +-%-4g max diff %g\n", bins[b], ranges[r], max_diff);
+            if (!(max_diff <= tolerance))
+                failed++;
+        }
+    }
+
+    DFLDecoder decoder;
+    if (decoder.create(0) == 0 || decoder.create(33) == 0)
+    {
+        fprintf(stderr, "create accepted an unsupported bin count\n");
+        failed++;
+    }
+
+    return failed == 0 ? 0 : 1;
+}
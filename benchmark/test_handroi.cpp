@@ -0,0 +1,152 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// hand_roi_to_input against the landmark preprocess it replaced: clone the roi, from_pixels_resize, then
+// copy every plane centered into the zero padded 224 x 224 input with 1/255
+// rois of a padded frame at every position and aspect, small ones that skip the resize, widths around the simd width
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "mat.h"
+
+#include "handroi.h"
+
+// LandmarkDetect::detect_one before hand_roi_to_input
+static void roi_reference(const cv::Mat& rgb, const cv::Rect& box, int target_size, ncnn::Mat& in_pad, float& scale, int& wpad, int& hpad)
+{
+    cv::Mat input = rgb(box).clone();
+    int w = input.cols;
+    int h = input.rows;
+    scale = 1.f;
+    if (w > h)
+    {
+        scale = (float)target_size / w;
+        w = target_size;
+        h = h * scale;
+    }
+    else
+    {
+        scale = (float)target_size / h;
+        h = target_size;
+        w = w * scale;
+    }
+
+    ncnn::Mat in = ncnn::Mat::from_pixels_resize(input.data, ncnn::Mat::PIXEL_RGB, input.cols, input.rows, w, h);
+    wpad = target_size - w;
+    hpad = target_size - h;
+
+    in_pad.create(target_size, target_size, 3);
+    for (int q = 0; q < 3; q++)
+    {
+        const float* ptr = in.channel(q);
+        ncnn::Mat out = in_pad.channel(q);
+        out.fill(0.f);
+
+        for (int y = 0; y < h; y++)
+        {
+            float* outptr = out.row(y + hpad / 2) + wpad / 2;
+            for (int x = 0; x < w; x++)
+            {
+                outptr[x] = ptr[x] * (1 / 255.f);
+            }
+            ptr += w;
+        }
+    }
+}
+
+int main()
+{
+    const int target_size = 224;
+
+    // a camera frame wider than its pixels, as a cropped rgb view is
+    const int width = 640;
+    const int height = 480;
+    std::vector<unsigned char> storage((width * 3 + 24) * height);
+    for (size_t i = 0; i < storage.size(); i++)
+    {
+        storage[i] = (unsigned char)(rand() % 256);
+    }
+    cv::Mat rgb(height, width, CV_8UC3, &storage[0], width * 3 + 24);
+
+    const int fixed[][4] = {
+        {0, 0, width, height},
+        {0, 0, 224, 224},
+        {10, 20, 224, 100},
+        {5, 7, 100, 224},
+        {width - 37, height - 51, 37, 51},
+        {3, 3, 1, 1},
+        {100, 100, 8, 300},
+        {200, 50, 231, 229}
+    };
+
+    std::vector<unsigned char> resized;
+    ncnn::Mat expected;
+    ncnn::Mat in_pad;
+
+    int failed = 0;
+    int cases = 0;
+    for (int t = 0; t < 2008; t++)
+    {
+        cv::Rect box;
+        if (t < 8)
+        {
+            box = cv::Rect(fixed[t][0], fixed[t][1], fixed[t][2], fixed[t][3]);
+        }
+        else
+        {
+            box.width = 1 + rand() % 400;
+            box.height = 1 + rand() % 400;
+            box.x = rand() % (width - box.width + 1);
+            box.y = rand() % (height - box.height + 1);
+        }
+
+        float expected_scale;
+        int expected_wpad;
+        int expected_hpad;
+        roi_reference(rgb, box, target_size, expected, expected_scale, expected_wpad, expected_hpad);
+
+        // reused across rois as on a hand slot, stale values must not leak into the border
+        in_pad.create(target_size, target_size, 3);
+        in_pad.fill(-1.f);
+
+        float scale;
+        int wpad;
+        int hpad;
+        hand_roi_to_input(rgb.data, (int)rgb.step[0], box.x, box.y, box.width, box.height, target_size, resized, in_pad, scale, wpad, hpad);
+
+        int mismatch = 0;
+        for (int q = 0; q < 3; q++)
+        {
+            if (memcmp(in_pad.channel(q), expected.channel(q), target_size * target_size * sizeof(float)) != 0)
+                mismatch++;
+        }
+
+        cases++;
+        if (mismatch || scale != expected_scale || wpad != expected_wpad || hpad != expected_hpad)
+        {
+            fprintf(stderr, "roi %d,%d %dx%d: %d planes differ, scale %f wpad %d hpad %d, expected %f %d %d\n", box.x, box.y, box.width, box.height, mismatch, scale, wpad, hpad, expected_scale, expected_wpad, expected_hpad);
+            failed++;
+        }
+    }
+
+    printf("%d of %d cases differ\n", failed, cases);
+
+    return failed == 0 ? 0 : 1;
+}
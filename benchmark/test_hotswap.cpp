@@ -0,0 +1,213 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// HotSwap with one thread reloading while another grabs the instance every frame, as the camera does
+// readers must never see a destroyed instance and must never be the ones destroying it
+// wait_idle() must not return while the worker is still destroying a retired instance
+// a factory that fails must leave the current instance published
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "hotswap.h"
+
+static const int ALIVE = 0x600d;
+
+static std::atomic<int> g_created(0);
+static std::atomic<int> g_destroyed(0);
+static std::atomic<int> g_destroyed_by_reader(0);
+
+// set on the reader thread only
+static thread_local bool t_reader = false;
+
+static void pause_a_little()
+{
+    for (volatile int i = 0; i < 2000; i++)
+    {
+    }
+}
+
+struct Model
+{
+    explicit Model(int _generation)
+        : alive(ALIVE), generation(_generation), weights(4096, _generation)
+    {
+        g_created++;
+    }
+
+    ~Model()
+    {
+        if (t_reader)
+            g_destroyed_by_reader++;
+
+        alive = 0;
+        g_destroyed++;
+    }
+
+    volatile int alive;
+    int generation;
+    std::vector<int> weights;
+};
+
+// destroyed slowly, like a detector unmapping its weights
+struct SlowModel
+{
+    ~SlowModel()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        destroyed = true;
+    }
+
+    static std::atomic<bool> destroyed;
+};
+
+std::atomic<bool> SlowModel::destroyed(false);
+
+static int test_slow_destroy()
+{
+    HotSwap<SlowModel> models;
+    models.publish(std::make_shared<SlowModel>());
+
+    // unload, then give the worker time to pick the instance up and start destroying it
+    models.publish(std::shared_ptr<SlowModel>());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    models.wait_idle();
+
+    if (!SlowModel::destroyed)
+    {
+        fprintf(stderr, "wait_idle returned while a retired instance was still being destroyed\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int test_failed_load()
+{
+    HotSwap<int> values;
+    values.publish(std::make_shared<int>(1));
+
+    // a load that got as far as building its instance before failing
+    values.load_async([](std::shared_ptr<int>& value) { value = std::make_shared<int>(2); return -1; });
+    values.wait_idle();
+
+    std::shared_ptr<int> value = values.get();
+    if (!value || *value != 1)
+    {
+        fprintf(stderr, "a failed load replaced the published instance\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int reloads = 5000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--reloads") == 0 && i + 1 < argc)
+            reloads = atoi(argv[++i]);
+    }
+
+    int failed = test_slow_destroy();
+    failed += test_failed_load();
+    int frames = 0;
+    int empty_frames = 0;
+    {
+        HotSwap<Model> models;
+
+        std::atomic<bool> done(false);
+        std::atomic<int> bad_reads(0);
+
+        std::thread reader([&]()
+        {
+            t_reader = true;
+
+            while (!done)
+            {
+                // one frame: hold the instance, use it, let it go
+                std::shared_ptr<Model> model = models.get();
+                frames++;
+                if (!model)
+                {
+                    empty_frames++;
+                    continue;
+                }
+
+                // long enough for reloads to publish while the frame still holds the old instance
+                for (int k = 0; k < 3; k++)
+                {
+                    if (model->alive != ALIVE || model->weights[k * 1000] != model->generation)
+                        bad_reads++;
+
+                    pause_a_little();
+                }
+            }
+        });
+
+        for (int i = 0; i < reloads; i++)
+        {
+            // every other reload is superseded before it starts, now and then an unload
+            models.load_async([i](std::shared_ptr<Model>& model) { model = std::make_shared<Model>(i); return 0; });
+            if (i % 97 == 0)
+                models.publish(std::shared_ptr<Model>());
+            if (i % 2 == 0)
+                models.wait_idle();
+
+            pause_a_little();
+        }
+
+        models.wait_idle();
+        done = true;
+        reader.join();
+        models.wait_idle();
+
+        if (bad_reads)
+        {
+            fprintf(stderr, "%d reads of a destroyed instance\n", (int)bad_reads);
+            failed++;
+        }
+
+        // only the published instance is still alive
+        if (g_created - g_destroyed != (models.get() ? 1 : 0))
+        {
+            fprintf(stderr, "created %d destroyed %d with the hotswap still up\n", (int)g_created, (int)g_destroyed);
+            failed++;
+        }
+    }
+
+    fprintf(stderr, "reloads %d  frames %d  empty %d  created %d  destroyed %d  destroyed by reader %d\n", reloads, frames, empty_frames, (int)g_created, (int)g_destroyed, (int)g_destroyed_by_reader);
+
+    if (g_destroyed_by_reader)
+    {
+        fprintf(stderr, "%d instances destroyed on the reader thread\n", (int)g_destroyed_by_reader);
+        failed++;
+    }
+
+    if (g_created != g_destroyed)
+    {
+        fprintf(stderr, "%d instances leaked\n", (int)(g_created - g_destroyed));
+        failed++;
+    }
+
+    return failed == 0 ? 0 : 1;
+}
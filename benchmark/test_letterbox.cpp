@@ -0,0 +1,190 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// Letterbox::resize_nv21 against a per pixel sampler that unrotates every output pixel
+// all 8 rotate types, odd roi origins and sizes, swapped channels and borders
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "mat.h"
+
+#include "letterbox.h"
+
+// maps a point of the rotated roi back into the roi, rotate_type follows kanna_rotate
+static void unrotate(int rotate_type, float x, float y, int roi_w, int roi_h, float& sx, float& sy)
+{
+    switch (rotate_type)
+    {
+    default:
+    case 1:
+        sx = x;
+        sy = y;
+        break;
+    case 2:
+        sx = roi_w - 1 - x;
+        sy = y;
+        break;
+    case 3:
+        sx = roi_w - 1 - x;
+        sy = roi_h - 1 - y;
+        break;
+    case 4:
+        sx = x;
+        sy = roi_h - 1 - y;
+        break;
+    case 5:
+        sx = y;
+        sy = x;
+        break;
+    case 6:
+        sx = y;
+        sy = roi_h - 1 - x;
+        break;
+    case 7:
+        sx = roi_w - 1 - y;
+        sy = roi_h - 1 - x;
+        break;
+    case 8:
+        sx = roi_w - 1 - y;
+        sy = x;
+        break;
+    }
+}
+
+// one output pixel, bilinear luma and nearest chroma at the absolute frame position
+static void sample_reference(const unsigned char* nv21, int nv21_width, int nv21_height,
+                             int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type,
+                             int w, int h, int dx, int dy, float rgb[3])
+{
+    const int rw = rotate_type <= 4 ? roi_w : roi_h;
+    const int rh = rotate_type <= 4 ? roi_h : roi_w;
+    const float scale_x = (float)rw / w;
+    const float scale_y = (float)rh / h;
+
+    const float fx = std::min(std::max((dx + 0.5f) * scale_x - 0.5f, 0.f), (float)(rw - 1));
+    const float fy = std::min(std::max((dy + 0.5f) * scale_y - 0.5f, 0.f), (float)(rh - 1));
+
+    float sx;
+    float sy;
+    unrotate(rotate_type, fx, fy, roi_w, roi_h, sx, sy);
+
+    const int sx0 = std::min((int)sx, roi_w - 1);
+    const int sy0 = std::min((int)sy, roi_h - 1);
+    const int sx1 = std::min(sx0 + 1, roi_w - 1);
+    const int sy1 = std::min(sy0 + 1, roi_h - 1);
+    const float ax = sx - sx0;
+    const float ay = sy - sy0;
+
+    const unsigned char* y0ptr = nv21 + (roi_y + sy0) * nv21_width + roi_x;
+    const unsigned char* y1ptr = nv21 + (roi_y + sy1) * nv21_width + roi_x;
+    const float yy0 = y0ptr[sx0] + (y0ptr[sx1] - y0ptr[sx0]) * ax;
+    const float yy1 = y1ptr[sx0] + (y1ptr[sx1] - y1ptr[sx0]) * ax;
+    const float yy = yy0 + (yy1 - yy0) * ay;
+
+    const unsigned char* vu = nv21 + nv21_width * nv21_height + (roi_y + sy0) / 2 * nv21_width + (roi_x + sx0) / 2 * 2;
+    const float v = vu[0] - 128.f;
+    const float u = vu[1] - 128.f;
+
+    rgb[0] = std::min(std::max(yy + 1.370705f * v, 0.f), 255.f);
+    rgb[1] = std::min(std::max(yy - 0.698001f * v - 0.337633f * u, 0.f), 255.f);
+    rgb[2] = std::min(std::max(yy + 1.732446f * u, 0.f), 255.f);
+}
+
+int main()
+{
+    srand(7);
+
+    const int nv21_width = 64;
+    const int nv21_height = 48;
+    std::vector<unsigned char> nv21(nv21_width * nv21_height * 3 / 2);
+    for (size_t i = 0; i < nv21.size(); i++)
+    {
+        nv21[i] = (unsigned char)(rand() % 256);
+    }
+
+    const float mean_vals[3] = {10.f, 20.f, 30.f};
+    const float norm_vals[3] = {0.5f, 0.25f, 2.f};
+
+    Letterbox letterbox;
+    ncnn::Mat out;
+
+    int failed = 0;
+    int cases = 0;
+    for (int t = 0; t < 400; t++)
+    {
+        // odd and even origins and sizes, down and up scaling
+        const int roi_x = rand() % 20;
+        const int roi_y = rand() % 16;
+        const int roi_w = 1 + rand() % (nv21_width - roi_x);
+        const int roi_h = 1 + rand() % (nv21_height - roi_y);
+        const int w = 1 + rand() % 48;
+        const int h = 1 + rand() % 48;
+        const int left = rand() % 4;
+        const int top = rand() % 4;
+        const int target_w = left + w + rand() % 4;
+        const int target_h = top + h + rand() % 4;
+        const bool swap_rb = rand() % 2 == 0;
+
+        for (int rotate_type = 1; rotate_type <= 8; rotate_type++)
+        {
+            cases++;
+
+            int ret = letterbox.resize_nv21(&nv21[0], nv21_width, nv21_height, roi_x, roi_y, roi_w, roi_h, rotate_type, swap_rb,
+                                            w, h, left, top, target_w, target_h, 114.f, mean_vals, norm_vals, out);
+            if (ret != 0 || out.w != target_w || out.h != target_h || out.c != 3)
+            {
+                fprintf(stderr, "resize_nv21 returned %d\n", ret);
+                failed++;
+                continue;
+            }
+
+            int mismatch = 0;
+            for (int y = 0; y < target_h; y++)
+            {
+                for (int x = 0; x < target_w; x++)
+                {
+                    const bool inside = x >= left && x < left + w && y >= top && y < top + h;
+
+                    float rgb[3] = {114.f, 114.f, 114.f};
+                    if (inside)
+                        sample_reference(&nv21[0], nv21_width, nv21_height, roi_x, roi_y, roi_w, roi_h, rotate_type, w, h, x - left, y - top, rgb);
+
+                    for (int q = 0; q < 3; q++)
+                    {
+                        const int c = swap_rb ? 2 - q : q;
+                        const float expected = (rgb[q] - mean_vals[c]) * norm_vals[c];
+                        // loose enough for fused multiply-add contraction on arm64
+                        if (fabsf(out.channel(c).row(y)[x] - expected) > 1e-3f)
+                            mismatch++;
+                    }
+                }
+            }
+
+            if (mismatch)
+            {
+                fprintf(stderr, "roi %d,%d %dx%d rotate %d to %dx%d: %d values differ\n", roi_x, roi_y, roi_w, roi_h, rotate_type, w, h, mismatch);
+                failed++;
+            }
+        }
+    }
+
+    printf("%d of %d cases differ\n", failed, cases);
+
+    return failed == 0 ? 0 : 1;
+}
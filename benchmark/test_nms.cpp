@@ -0,0 +1,111 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// BoxNms against a stable sorted greedy nms, with many equal scores
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "nms.h"
+
+struct Box
+{
+    float x, y, w, h;
+    float score;
+    int index;
+};
+
+static bool box_score_greater(const Box& a, const Box& b)
+{
+    return a.score > b.score;
+}
+
+static float iou(const Box& a, const Box& b)
+{
+    float w = std::min(a.x + a.w, b.x + b.w) - std::max(a.x, b.x);
+    float h = std::min(a.y + a.h, b.y + b.h) - std::max(a.y, b.y);
+    float inter = std::max(w, 0.f) * std::max(h, 0.f);
+    return inter / (a.w * a.h + b.w * b.h - inter);
+}
+
+static void nms_reference(std::vector<Box> boxes, std::vector<int>& picked, float nms_threshold, int topk)
+{
+    std::stable_sort(boxes.begin(), boxes.end(), box_score_greater);
+    if (topk > 0 && topk < (int)boxes.size())
+        boxes.resize(topk);
+
+    std::vector<Box> kept;
+    picked.clear();
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        bool keep = true;
+        for (size_t j = 0; keep && j < kept.size(); j++)
+        {
+            keep = !(iou(boxes[i], kept[j]) > nms_threshold);
+        }
+
+        if (keep)
+        {
+            kept.push_back(boxes[i]);
+            picked.push_back(boxes[i].index);
+        }
+    }
+}
+
+int main()
+{
+    srand(7);
+
+    int failed = 0;
+    BoxNms nms;
+    std::vector<int> picked;
+    std::vector<int> expected;
+    for (int t = 0; t < 2000; t++)
+    {
+        const int n = 1 + rand() % 400;
+        // few distinct levels so most scores tie
+        const int levels = 1 + rand() % 8;
+        const int topk = rand() % 2 ? 300 : -1;
+
+        std::vector<Box> boxes(n);
+        nms.clear();
+        for (int i = 0; i < n; i++)
+        {
+            Box& b = boxes[i];
+            b.x = (float)(rand() % 300);
+            b.y = (float)(rand() % 300);
+            b.w = (float)(10 + rand() % 100);
+            b.h = (float)(10 + rand() % 100);
+            b.score = (1 + rand() % levels) / (float)levels;
+            b.index = i;
+            nms.push_back(b.x, b.y, b.w, b.h, b.score);
+        }
+
+        nms.run(picked, 0.45f, topk);
+        nms_reference(boxes, expected, 0.45f, topk);
+
+        if (picked != expected)
+        {
+            fprintf(stderr, "case %d: %d boxes, %d levels, topk %d picked %d expected %d\n", t, n, levels, topk, (int)picked.size(), (int)expected.size());
+            failed++;
+        }
+    }
+
+    printf("%d of 2000 cases differ\n", failed);
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,323 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// the camera frame converters against the code they replaced
+// yuv420_to_nv21 against the per pixel repack loop, planar and semi-planar chroma, padded rows
+// nv21_roi_rotate_to_rgb against crop + kanna_rotate_c1 + kanna_rotate_c2 + yuv420sp2rgb, all 8 rotate types and offset rois
+// nv21_unrotate_roi + nv21_roi_copy against cropping the rotated frame
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "mat.h"
+
+#include "nv21.h"
+
+// a YUV_420_888 image as the camera hands it over, planes exactly as large as their last row needs
+struct Yuv420
+{
+    int width;
+    int height;
+    std::vector<unsigned char> y;
+    std::vector<unsigned char> chroma;
+    int y_rowstride;
+    int uv_rowstride;
+    int uv_pixelstride;
+    // u and v offsets into chroma
+    int u_offset;
+    int v_offset;
+};
+
+// layout 0 planar u then v, 1 semi-planar uv (nv12), 2 semi-planar vu (nv21)
+static void make_yuv420(int width, int height, int padding, int layout, Yuv420& img)
+{
+    img.width = width;
+    img.height = height;
+    img.y_rowstride = width + padding;
+    img.y.resize(img.y_rowstride * (height - 1) + width);
+    for (size_t i = 0; i < img.y.size(); i++)
+    {
+        img.y[i] = (unsigned char)(rand() % 256);
+    }
+
+    const int half_width = width / 2;
+    const int half_height = height / 2;
+    if (layout == 0)
+    {
+        img.uv_pixelstride = 1;
+        img.uv_rowstride = half_width + padding;
+        const int plane_size = img.uv_rowstride * (half_height - 1) + half_width;
+        img.chroma.resize(plane_size * 2);
+        img.u_offset = 0;
+        img.v_offset = plane_size;
+    }
+    else
+    {
+        img.uv_pixelstride = 2;
+        img.uv_rowstride = width + padding;
+        // the second plane starts one byte in and ends one byte past the first, as on android
+        img.chroma.resize(img.uv_rowstride * (half_height - 1) + width);
+        img.u_offset = layout == 1 ? 0 : 1;
+        img.v_offset = layout == 1 ? 1 : 0;
+    }
+
+    for (size_t i = 0; i < img.chroma.size(); i++)
+    {
+        img.chroma[i] = (unsigned char)(rand() % 256);
+    }
+}
+
+// the repack loop before yuv420_to_nv21
+static void repack_reference(const Yuv420& img, unsigned char* nv21)
+{
+    for (int y = 0; y < img.height; y++)
+    {
+        for (int x = 0; x < img.width; x++)
+        {
+            nv21[y * img.width + x] = img.y[y * img.y_rowstride + x];
+        }
+    }
+
+    unsigned char* vu = nv21 + img.width * img.height;
+    for (int y = 0; y < img.height / 2; y++)
+    {
+        for (int x = 0; x < img.width / 2; x++)
+        {
+            const int offset = y * img.uv_rowstride + x * img.uv_pixelstride;
+            vu[y * img.width + x * 2] = img.chroma[img.v_offset + offset];
+            vu[y * img.width + x * 2 + 1] = img.chroma[img.u_offset + offset];
+        }
+    }
+}
+
+static void repack(const Yuv420& img, unsigned char* nv21)
+{
+    yuv420_to_nv21(&img.y[0], img.y_rowstride, 1,
+                   &img.chroma[img.u_offset], img.uv_rowstride, img.uv_pixelstride,
+                   &img.chroma[img.v_offset], img.uv_rowstride, img.uv_pixelstride,
+                   img.width, img.height, nv21);
+}
+
+// crop the roi, rotate y and vu with kanna_rotate, then yuv420sp2rgb, the camera path before nv21_roi_rotate_to_rgb
+static void rotate_reference(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, std::vector<unsigned char>& rgb)
+{
+    std::vector<unsigned char> roi(roi_w * roi_h * 3 / 2);
+    for (int y = 0; y < roi_h; y++)
+    {
+        memcpy(&roi[y * roi_w], nv21 + (roi_y + y) * nv21_width + roi_x, roi_w);
+    }
+    for (int y = 0; y < roi_h / 2; y++)
+    {
+        memcpy(&roi[roi_w * roi_h + y * roi_w], nv21 + nv21_width * nv21_height + (roi_y / 2 + y) * nv21_width + roi_x, roi_w);
+    }
+
+    const int w = rotate_type <= 4 ? roi_w : roi_h;
+    const int h = rotate_type <= 4 ? roi_h : roi_w;
+
+    std::vector<unsigned char> rotated(w * h * 3 / 2);
+    ncnn::kanna_rotate_c1(&roi[0], roi_w, roi_h, &rotated[0], w, h, rotate_type);
+    ncnn::kanna_rotate_c2(&roi[roi_w * roi_h], roi_w / 2, roi_h / 2, roi_w, &rotated[w * h], w / 2, h / 2, w, rotate_type);
+
+    rgb.resize(w * h * 3);
+    ncnn::yuv420sp2rgb(&rotated[0], w, h, &rgb[0]);
+}
+
+static int test_repack()
+{
+    const int widths[] = {2, 6, 16, 30, 34, 64, 66, 98};
+    const int heights[] = {2, 4, 10, 22};
+    const int paddings[] = {0, 13, 64};
+
+    int failed = 0;
+    int cases = 0;
+    for (int layout = 0; layout < 3; layout++)
+    {
+        for (int wi = 0; wi < 8; wi++)
+        {
+            for (int hi = 0; hi < 4; hi++)
+            {
+                for (int pi = 0; pi < 3; pi++)
+                {
+                    Yuv420 img;
+                    make_yuv420(widths[wi], heights[hi], paddings[pi], layout, img);
+
+                    std::vector<unsigned char> expected(img.width * img.height * 3 / 2);
+                    std::vector<unsigned char> nv21(expected.size());
+                    repack_reference(img, &expected[0]);
+                    repack(img, &nv21[0]);
+
+                    cases++;
+                    if (nv21 != expected)
+                    {
+                        fprintf(stderr, "yuv420_to_nv21 layout %d %dx%d padding %d differs\n", layout, img.width, img.height, paddings[pi]);
+                        failed++;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("yuv420_to_nv21: %d of %d cases differ\n", failed, cases);
+    return failed;
+}
+
+static int test_rotate()
+{
+    const int sizes[][2] = {{64, 48}, {30, 22}, {100, 38}};
+
+    int failed = 0;
+    int cases = 0;
+    for (int si = 0; si < 3; si++)
+    {
+        const int nv21_width = sizes[si][0];
+        const int nv21_height = sizes[si][1];
+
+        // camera frames reach the converter through the repack, both chroma layouts
+        for (int layout = 0; layout < 3; layout += 2)
+        {
+            Yuv420 img;
+            make_yuv420(nv21_width, nv21_height, 8, layout, img);
+
+            std::vector<unsigned char> nv21(nv21_width * nv21_height * 3 / 2);
+            repack(img, &nv21[0]);
+
+            const int rois[][4] = {
+                {0, 0, nv21_width, nv21_height},
+                {2, 4, nv21_width - 6, nv21_height - 8},
+                {10, 2, 18, 14},
+                {nv21_width - 20, nv21_height - 12, 20, 12},
+                {4, 6, 2, 2}
+            };
+
+            for (int ri = 0; ri < 5; ri++)
+            {
+                const int roi_x = rois[ri][0];
+                const int roi_y = rois[ri][1];
+                const int roi_w = rois[ri][2];
+                const int roi_h = rois[ri][3];
+
+                for (int rotate_type = 1; rotate_type <= 8; rotate_type++)
+                {
+                    std::vector<unsigned char> expected;
+                    rotate_reference(&nv21[0], nv21_width, nv21_height, roi_x, roi_y, roi_w, roi_h, rotate_type, expected);
+
+                    const int w = rotate_type <= 4 ? roi_w : roi_h;
+                    const int h = rotate_type <= 4 ? roi_h : roi_w;
+
+                    // padded rgb rows, the padding must stay untouched
+                    const int rgb_stride = w * 3 + 5;
+                    std::vector<unsigned char> rgb(rgb_stride * h, 0xa5);
+                    nv21_roi_rotate_to_rgb(&nv21[0], nv21_width, nv21_height, roi_x, roi_y, roi_w, roi_h, rotate_type, &rgb[0], rgb_stride);
+
+                    int mismatch = 0;
+                    for (int y = 0; y < h; y++)
+                    {
+                        if (memcmp(&rgb[y * rgb_stride], &expected[y * w * 3], w * 3) != 0)
+                            mismatch++;
+
+                        for (int x = w * 3; x < rgb_stride; x++)
+                        {
+                            if (rgb[y * rgb_stride + x] != 0xa5)
+                                mismatch++;
+                        }
+                    }
+
+                    cases++;
+                    if (mismatch)
+                    {
+                        fprintf(stderr, "nv21_roi_rotate_to_rgb %dx%d layout %d roi %d,%d %dx%d rotate %d: %d rows differ\n", nv21_width, nv21_height, layout, roi_x, roi_y, roi_w, roi_h, rotate_type, mismatch);
+                        failed++;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("nv21_roi_rotate_to_rgb: %d of %d cases differ\n", failed, cases);
+    return failed;
+}
+
+static int test_roi_copy()
+{
+    const int nv21_width = 64;
+    const int nv21_height = 48;
+
+    std::vector<unsigned char> nv21(nv21_width * nv21_height * 3 / 2);
+    for (size_t i = 0; i < nv21.size(); i++)
+    {
+        nv21[i] = (unsigned char)(rand() % 256);
+    }
+
+    int failed = 0;
+    int cases = 0;
+    for (int rotate_type = 1; rotate_type <= 8; rotate_type++)
+    {
+        const int w = rotate_type <= 4 ? nv21_width : nv21_height;
+        const int h = rotate_type <= 4 ? nv21_height : nv21_width;
+
+        std::vector<unsigned char> full(w * h * 3);
+        nv21_roi_rotate_to_rgb(&nv21[0], nv21_width, nv21_height, 0, 0, nv21_width, nv21_height, rotate_type, &full[0], w * 3);
+
+        for (int t = 0; t < 50; t++)
+        {
+            // an even roi of the rotated frame, as the camera window crop picks it
+            const int rx = rand() % (w / 2) * 2;
+            const int ry = rand() % (h / 2) * 2;
+            const int rw = 2 + rand() % ((w - rx) / 2) * 2;
+            const int rh = 2 + rand() % ((h - ry) / 2) * 2;
+
+            int roi_x = rx;
+            int roi_y = ry;
+            int roi_w = rw;
+            int roi_h = rh;
+            nv21_unrotate_roi(nv21_width, nv21_height, rotate_type, roi_x, roi_y, roi_w, roi_h);
+
+            std::vector<unsigned char> roi(roi_w * roi_h * 3 / 2);
+            nv21_roi_copy(&nv21[0], nv21_width, nv21_height, roi_x, roi_y, roi_w, roi_h, &roi[0]);
+
+            std::vector<unsigned char> rgb(rw * rh * 3);
+            nv21_roi_rotate_to_rgb(&roi[0], roi_w, roi_h, 0, 0, roi_w, roi_h, rotate_type, &rgb[0], rw * 3);
+
+            int mismatch = 0;
+            for (int y = 0; y < rh; y++)
+            {
+                if (memcmp(&rgb[y * rw * 3], &full[((ry + y) * w + rx) * 3], rw * 3) != 0)
+                    mismatch++;
+            }
+
+            cases++;
+            if (mismatch)
+            {
+                fprintf(stderr, "nv21_roi_copy rotate %d roi %d,%d %dx%d: %d rows differ\n", rotate_type, rx, ry, rw, rh, mismatch);
+                failed++;
+            }
+        }
+    }
+
+    printf("nv21_unrotate_roi + nv21_roi_copy: %d of %d cases differ\n", failed, cases);
+    return failed;
+}
+
+int main()
+{
+    int failed = 0;
+    failed += test_repack();
+    failed += test_rotate();
+    failed += test_roi_copy();
+
+    return failed == 0 ? 0 : 1;
+}
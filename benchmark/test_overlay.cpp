@@ -0,0 +1,212 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// the non antialiased Overlay raster against golden masks, lines and circles pinned pixel for pixel,
+// cached label glyphs against cv::putText of the same character drawn straight into the frame
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "overlay.h"
+
+static const unsigned char white[3] = {255, 255, 255};
+
+// label font, as Overlay draws it
+static const int font_face = cv::FONT_HERSHEY_SIMPLEX;
+static const double font_scale = 0.5;
+static const int font_thickness = 1;
+
+// a bresenham line from 1,1 to 10,4
+static const char* const golden_line[] = {
+    "............",
+    ".##.........",
+    "...###......",
+    "......###...",
+    ".........##.",
+    "............",
+};
+
+// 5,1 to 2,8 with the 2 pixel brush of the hand bones
+static const char* const golden_thick_line[] = {
+    "....##..",
+    "....##..",
+    "...###..",
+    "...##...",
+    "..###...",
+    "..##....",
+    ".###....",
+    ".##.....",
+    ".##.....",
+    "........",
+};
+
+// radius 4 around 5,5, the hand joints
+static const char* const golden_circle[] = {
+    "...........",
+    ".....#.....",
+    "...#####...",
+    "..#######..",
+    "..#######..",
+    ".#########.",
+    "..#######..",
+    "..#######..",
+    "...#####...",
+    ".....#.....",
+    "...........",
+};
+
+// image against the golden rows starting at x0, y0, '#' where a pixel is drawn
+static int compare_golden(const char* name, const cv::Mat& image, const char* const* golden, int x0, int y0)
+{
+    const int cn = image.channels();
+
+    int diff = 0;
+    for (int y = 0; y < image.rows; y++)
+    {
+        const unsigned char* p = image.ptr<const unsigned char>(y);
+        for (int x = 0; x < image.cols; x++)
+        {
+            const bool drawn = p[0] || p[1] || p[2];
+            if (drawn != (golden[y0 + y][x0 + x] == '#'))
+                diff++;
+
+            // rgba frames get an opaque alpha where drawn and keep it elsewhere
+            if (cn == 4 && p[3] != (drawn ? 255 : 0))
+                diff++;
+
+            p += cn;
+        }
+    }
+
+    if (diff)
+        fprintf(stderr, "%s: %d pixels differ from the golden mask\n", name, diff);
+
+    return diff ? 1 : 0;
+}
+
+static int test_lines_and_circles()
+{
+    int failed = 0;
+
+    Overlay overlay;
+
+    for (int cn = 3; cn <= 4; cn++)
+    {
+        const int type = cn == 3 ? CV_8UC3 : CV_8UC4;
+
+        cv::Mat line = cv::Mat::zeros(6, 12, type);
+        overlay.begin(line);
+        overlay.line(cv::Point(1, 1), cv::Point(10, 4), white, 1);
+        overlay.end();
+        failed += compare_golden("line", line, golden_line, 0, 0);
+
+        // drawn from the other end the same pixels light up
+        cv::Mat reversed = cv::Mat::zeros(10, 8, type);
+        overlay.begin(reversed);
+        overlay.line(cv::Point(2, 8), cv::Point(5, 1), white, 2);
+        overlay.end();
+        failed += compare_golden("thick line", reversed, golden_thick_line, 0, 0);
+
+        cv::Mat circle = cv::Mat::zeros(11, 11, type);
+        overlay.begin(circle);
+        overlay.circle(cv::Point(5, 5), 4, white);
+        overlay.end();
+        failed += compare_golden("circle", circle, golden_circle, 0, 0);
+
+        // a joint on the frame corner keeps its inside quarter and writes nothing outside
+        cv::Mat corner = cv::Mat::zeros(6, 6, type);
+        overlay.begin(corner);
+        overlay.circle(cv::Point(1, 1), 4, white);
+        overlay.end();
+        failed += compare_golden("clipped circle", corner, golden_circle, 4, 4);
+    }
+
+    return failed;
+}
+
+static int count_row_diffs(const cv::Mat& a, const cv::Mat& b)
+{
+    int diff = 0;
+    for (int y = 0; y < a.rows; y++)
+    {
+        diff += memcmp(a.ptr<const unsigned char>(y), b.ptr<const unsigned char>(y), a.cols * a.channels()) != 0;
+    }
+    return diff;
+}
+
+// every printable glyph out of the cache against cv::putText,
+// then cut by the frame edges against the same glyph drawn whole
+static int test_glyphs()
+{
+    int baseline = 0;
+    const int text_height = cv::getTextSize("0", font_face, font_scale, font_thickness, &baseline).height;
+
+    Overlay overlay;
+
+    int failed = 0;
+    for (int c = 32; c < 127; c++)
+    {
+        const char text[2] = {(char)c, 0};
+
+        // inside the frame, opencv clips strokes on its own and would not draw the same pixels at the edges
+        cv::Mat expected = cv::Mat::zeros(40, 40, CV_8UC3);
+        cv::putText(expected, text, cv::Point(12, 10 + text_height), font_face, font_scale, cv::Scalar(255, 255, 255), font_thickness);
+
+        cv::Mat image = cv::Mat::zeros(40, 40, CV_8UC3);
+        overlay.begin(image);
+        overlay.text(12, 10, text, white);
+        overlay.end();
+
+        int diff = count_row_diffs(image, expected);
+        if (diff)
+        {
+            fprintf(stderr, "glyph '%c': %d rows differ from cv::putText\n", c, diff);
+            failed++;
+        }
+
+        // windows of the frame above cutting the glyph on the left and top, then right and bottom
+        const cv::Rect windows[] = {cv::Rect(14, 14, 12, 12), cv::Rect(0, 0, 15, 16)};
+        for (int w = 0; w < 2; w++)
+        {
+            const cv::Rect& window = windows[w];
+
+            cv::Mat cut = cv::Mat::zeros(window.height, window.width, CV_8UC3);
+            overlay.begin(cut);
+            overlay.text(12 - window.x, 10 - window.y, text, white);
+            overlay.end();
+
+            diff = count_row_diffs(cut, image(window));
+            if (diff)
+            {
+                fprintf(stderr, "glyph '%c' cut at %d,%d: %d rows differ from the whole glyph\n", c, window.x, window.y, diff);
+                failed++;
+            }
+        }
+    }
+
+    return failed;
+}
+
+int main()
+{
+    int failed = 0;
+    failed += test_lines_and_circles();
+    failed += test_glyphs();
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// FramePipeline with the camera thread capturing while another thread restarts the pipeline,
+// a frame must never be refilled while inference or render still hold it
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "pipeline.h"
+
+struct TestFrame
+{
+    // written twice by capture with a pause in between, inference and render must see them equal
+    volatile int a;
+    volatile int b;
+    // written by inference, render must see it unchanged
+    volatile int c;
+};
+
+static std::atomic<int> g_torn(0);
+static std::atomic<int> g_inferred(0);
+static std::atomic<int> g_rendered(0);
+
+static void pause_a_little(int n = 200)
+{
+    for (volatile int i = 0; i < n; i++)
+    {
+    }
+}
+
+static void infer(TestFrame& frame)
+{
+    const int a = frame.a;
+    if (a != frame.b)
+        g_torn++;
+
+    frame.c = a;
+    pause_a_little();
+
+    if (frame.a != a || frame.b != a)
+        g_torn++;
+
+    g_inferred++;
+}
+
+static void render(TestFrame& frame)
+{
+    const int c = frame.c;
+    pause_a_little();
+
+    if (frame.a != c || frame.b != c || frame.c != c)
+        g_torn++;
+
+    g_rendered++;
+}
+
+int main(int argc, char** argv)
+{
+    int restarts = 10000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--restarts") == 0 && i + 1 < argc)
+            restarts = atoi(argv[++i]);
+    }
+
+    FramePipeline<TestFrame> pipeline;
+
+    std::atomic<bool> done(false);
+    int captured = 0;
+    std::thread camera([&]()
+    {
+        int n = 0;
+        while (!done)
+        {
+            n++;
+            bool queued = pipeline.capture([&](TestFrame& frame)
+            {
+                frame.a = n;
+                // long enough for restarts to land in the middle of a fill
+                pause_a_little(5000);
+                frame.b = n;
+            });
+            if (queued)
+                captured++;
+        }
+    });
+
+    // open and close the camera window while frames keep coming
+    for (int i = 0; i < restarts; i++)
+    {
+        pipeline.start(infer, render);
+        std::this_thread::sleep_for(std::chrono::microseconds(i % 7 * 20));
+        pipeline.stop();
+    }
+
+    done = true;
+    camera.join();
+
+    fprintf(stderr, "restarts %d  captured %d  inferred %d  rendered %d  torn %d\n", restarts, captured, (int)g_inferred, (int)g_rendered, (int)g_torn);
+
+    if (captured == 0 || g_inferred == 0)
+    {
+        fprintf(stderr, "no frame went through the pipeline\n");
+        return 1;
+    }
+
+    return g_torn == 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// HandTracker on a scripted sequence: a detected hand moving across the frame,
+// redetect cadence, label and score carried over, collapsing and escaping keypoints
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "tracker.h"
+
+static int g_failed = 0;
+
+#define CHECK(cond)                                                    \
+    do                                                                 \
+    {                                                                  \
+        if (!(cond))                                                   \
+        {                                                              \
+            fprintf(stderr, "%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failed++;                                                \
+        }                                                              \
+    } while (0)
+
+// 21 keypoints of an open hand of the given size, wrist at the bottom
+static HandLandmarks make_hand(float cx, float cy, float size)
+{
+    HandLandmarks hand;
+    hand.score = 0.9f;
+    hand.pts[0] = cv::Point2f(cx, cy + size * 0.5f);
+    for (int f = 0; f < 5; f++)
+    {
+        const float fx = cx + (f - 2) * size * 0.2f;
+        for (int j = 0; j < 4; j++)
+        {
+            hand.pts[1 + f * 4 + j] = cv::Point2f(fx, cy + size * (0.3f - j * 0.25f));
+        }
+    }
+    return hand;
+}
+
+static bool contains(const cv::Rect& roi, const HandLandmarks& hand)
+{
+    for (int i = 0; i < 21; i++)
+    {
+        if (hand.pts[i].x < roi.x || hand.pts[i].x >= roi.x + roi.width || hand.pts[i].y < roi.y || hand.pts[i].y >= roi.y + roi.height)
+            return false;
+    }
+    return true;
+}
+
+int main()
+{
+    const int img_w = 640;
+    const int img_h = 480;
+
+    HandTracker tracker;
+    tracker.set_params(0.8f, 10);
+
+    CHECK(tracker.need_detect());
+
+    std::vector<cv::Rect> rois(1);
+    std::vector<HandLandmarks> hands(1);
+    std::vector<int> labels(1, 1);
+    std::vector<float> probs(1, 0.87f);
+
+    // detector frame
+    float cx = 200.f;
+    float cy = 240.f;
+    hands[0] = make_hand(cx, cy, 120.f);
+    rois[0] = cv::Rect(130, 170, 140, 140);
+    CHECK(HandTracker::keypoint_confidence(hands[0], rois[0]) == 1.f);
+    tracker.update(rois, hands, labels, probs, true, img_w, img_h);
+
+    CHECK(!tracker.need_detect());
+    CHECK(tracker.tracks().size() == 1);
+
+    // the hand moves 6 px per frame, each roi comes from the previous keypoints
+    for (int frame = 1; frame <= 10; frame++)
+    {
+        CHECK(!tracker.need_detect());
+        CHECK(tracker.tracks().size() == 1);
+        if (tracker.tracks().size() != 1)
+            return 1;
+
+        const HandTrack& track = tracker.tracks()[0];
+        CHECK(track.label == 1);
+        CHECK(track.prob == 0.87f);
+
+        cx += 6.f;
+        cy -= 3.f;
+        hands[0] = make_hand(cx, cy, 120.f);
+        rois[0] = track.roi;
+        labels[0] = track.label;
+        probs[0] = track.prob;
+
+        // the grown roi leaves room for the motion
+        CHECK(contains(rois[0], hands[0]));
+
+        tracker.update(rois, hands, labels, probs, false, img_w, img_h);
+    }
+
+    // redetect_interval tracked frames later the detector is due again
+    CHECK(tracker.need_detect());
+
+    // a fresh detection resets the cadence and replaces the carried score
+    probs[0] = 0.65f;
+    tracker.update(rois, hands, labels, probs, true, img_w, img_h);
+    CHECK(!tracker.need_detect());
+    CHECK(tracker.tracks().size() == 1 && tracker.tracks()[0].prob == 0.65f);
+
+    // keypoints collapsing to a blob lose the hand
+    rois[0] = tracker.tracks()[0].roi;
+    for (int i = 0; i < 21; i++)
+    {
+        hands[0].pts[i] = cv::Point2f(rois[0].x + rois[0].width * 0.5f, rois[0].y + rois[0].height * 0.5f);
+    }
+    CHECK(HandTracker::keypoint_confidence(hands[0], rois[0]) == 0.f);
+    tracker.update(rois, hands, labels, probs, false, img_w, img_h);
+    CHECK(tracker.need_detect());
+    CHECK(tracker.tracks().empty());
+
+    // keypoints mostly outside the roi lose the hand too
+    hands[0] = make_hand(cx, cy, 120.f);
+    rois[0] = cv::Rect((int)cx - 70, (int)cy - 70, 140, 140);
+    tracker.update(rois, hands, labels, probs, true, img_w, img_h);
+    CHECK(!tracker.need_detect());
+    rois[0] = tracker.tracks()[0].roi;
+    hands[0] = make_hand(cx + 90.f, cy, 120.f);
+    CHECK(HandTracker::keypoint_confidence(hands[0], rois[0]) < 0.8f);
+    tracker.update(rois, hands, labels, probs, false, img_w, img_h);
+    CHECK(tracker.need_detect());
+
+    // redetect_interval 0 runs the detector on every frame
+    tracker.reset();
+    tracker.set_params(0.8f, 0);
+    hands[0] = make_hand(320.f, 240.f, 120.f);
+    rois[0] = cv::Rect(250, 170, 140, 140);
+    tracker.update(rois, hands, labels, probs, true, img_w, img_h);
+    CHECK(tracker.need_detect());
+
+    printf("%d checks failed\n", g_failed);
+
+    return g_failed == 0 ? 0 : 1;
+}
@@ -23,6 +23,9 @@ public class NanoDetNcnn
     public native boolean openCamera(int facing);
     public native boolean closeCamera();
     public native boolean setOutputWindow(Surface surface);
+    public native float[] getStageLatency();
+    public native boolean startTrace();
+    public native boolean dumpTrace(String path);
 
     static {
         System.loadLibrary("nanodetncnn");
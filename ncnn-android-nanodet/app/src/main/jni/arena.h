@@ -0,0 +1,92 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include <allocator.h>
+
+#define ARENA_BIN_COUNT 128
+
+// ncnn allocator carving blocks out of a few large chunks
+// blocks come in size classes, four per power of two, and a freed block goes on the free list of its class
+// for the next allocation of that class, so a steady state frame never reaches the system allocator.
+// no locking, give every net on every thread its own, see LockedArenaAllocator for workspaces
+class ArenaAllocator : public ncnn::Allocator
+{
+public:
+    ArenaAllocator();
+    virtual ~ArenaAllocator();
+
+    virtual void* fastMalloc(size_t size);
+    virtual void fastFree(void* ptr);
+
+    // frame boundary, a no-op while any block is still out
+    // otherwise every block returns to the arena at once and the chunks are merged into one
+    void reset();
+
+    // bytes of the blocks handed out right now, and the most at any time, size class slack included
+    size_t current_bytes() const;
+    size_t peak_bytes() const;
+
+    // bytes held from the system
+    size_t reserved_bytes() const;
+
+private:
+    ArenaAllocator(const ArenaAllocator&);
+    ArenaAllocator& operator=(const ArenaAllocator&);
+
+    unsigned char* carve(size_t size);
+    void release_chunks();
+
+    struct Chunk
+    {
+        unsigned char* data;
+        size_t size;
+        size_t used;
+    };
+
+    std::vector<Chunk> chunks;
+    std::vector<unsigned char*> bins[ARENA_BIN_COUNT];
+
+    size_t current;
+    size_t peak;
+    size_t reserved;
+    int outstanding;
+};
+
+// ArenaAllocator behind a lock, like ncnn PoolAllocator next to UnlockedPoolAllocator
+// layers may take workspace from inside their openmp loops when the extractor runs on several threads,
+// so workspace allocators need this one, blob allocators are only called from the extracting thread
+class LockedArenaAllocator : public ArenaAllocator
+{
+public:
+    virtual void* fastMalloc(size_t size);
+    virtual void fastFree(void* ptr);
+
+    void reset();
+
+    size_t current_bytes() const;
+    size_t peak_bytes() const;
+    size_t reserved_bytes() const;
+
+private:
+    mutable ncnn::Mutex lock;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,163 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "blit.h"
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif // __ARM_NEON
+
+// rotate types 1~4, every output row is one source row walked forward or backward
+static void blit_rows(const unsigned char* rgb, int stride, unsigned char* rgba, int outw, int outh, int outstride, bool mirror_x, bool mirror_y)
+{
+    for (int y = 0; y < outh; y++)
+    {
+        const int sy = mirror_y ? outh - 1 - y : y;
+        unsigned char* outptr = rgba + outstride * y;
+
+        if (!mirror_x)
+        {
+            const unsigned char* ptr = rgb + stride * sy;
+
+            int x = 0;
+#if __ARM_NEON
+            for (; x + 7 < outw; x += 8)
+            {
+                uint8x8x3_t _rgb = vld3_u8(ptr);
+                uint8x8x4_t _rgba;
+                _rgba.val[0] = _rgb.val[0];
+                _rgba.val[1] = _rgb.val[1];
+                _rgba.val[2] = _rgb.val[2];
+                _rgba.val[3] = vdup_n_u8(255);
+                vst4_u8(outptr, _rgba);
+
+                ptr += 24;
+                outptr += 32;
+            }
+#endif // __ARM_NEON
+            for (; x < outw; x++)
+            {
+                outptr[0] = ptr[0];
+                outptr[1] = ptr[1];
+                outptr[2] = ptr[2];
+                outptr[3] = 255;
+
+                ptr += 3;
+                outptr += 4;
+            }
+        }
+        else
+        {
+            // last pixel of the source row first
+            const unsigned char* ptr = rgb + stride * sy + (outw - 1) * 3;
+
+            int x = 0;
+#if __ARM_NEON
+            for (; x + 7 < outw; x += 8)
+            {
+                uint8x8x3_t _rgb = vld3_u8(ptr - 21);
+                uint8x8x4_t _rgba;
+                _rgba.val[0] = vrev64_u8(_rgb.val[0]);
+                _rgba.val[1] = vrev64_u8(_rgb.val[1]);
+                _rgba.val[2] = vrev64_u8(_rgb.val[2]);
+                _rgba.val[3] = vdup_n_u8(255);
+                vst4_u8(outptr, _rgba);
+
+                ptr -= 24;
+                outptr += 32;
+            }
+#endif // __ARM_NEON
+            for (; x < outw; x++)
+            {
+                outptr[0] = ptr[0];
+                outptr[1] = ptr[1];
+                outptr[2] = ptr[2];
+                outptr[3] = 255;
+
+                ptr -= 3;
+                outptr += 4;
+            }
+        }
+    }
+}
+
+// rotate types 5~8, every output row is one source column
+// walk the output in tiles so the source rows of a tile stay in cache
+static void blit_columns(const unsigned char* rgb, int w, int h, int stride, unsigned char* rgba, int outw, int outh, int outstride, bool mirror_x, bool mirror_y)
+{
+    // output (x, y) reads source column sx = mirror_x ? w - 1 - y : y and row sy = mirror_y ? h - 1 - x : x
+    const int tile = 16;
+
+    for (int ty = 0; ty < outh; ty += tile)
+    {
+        const int ty1 = ty + tile < outh ? ty + tile : outh;
+
+        for (int tx = 0; tx < outw; tx += tile)
+        {
+            const int tx1 = tx + tile < outw ? tx + tile : outw;
+
+            for (int y = ty; y < ty1; y++)
+            {
+                const int sx = mirror_x ? w - 1 - y : y;
+                const int sy = mirror_y ? h - 1 - tx : tx;
+                const int sstep = mirror_y ? -stride : stride;
+
+                const unsigned char* ptr = rgb + stride * sy + sx * 3;
+                unsigned char* outptr = rgba + outstride * y + tx * 4;
+
+                for (int x = tx; x < tx1; x++)
+                {
+                    outptr[0] = ptr[0];
+                    outptr[1] = ptr[1];
+                    outptr[2] = ptr[2];
+                    outptr[3] = 255;
+
+                    ptr += sstep;
+                    outptr += 4;
+                }
+            }
+        }
+    }
+}
+
+void rgb_rotate_to_rgba(const unsigned char* rgb, int w, int h, int stride, unsigned char* rgba, int outw, int outh, int outstride, int rotate_type)
+{
+    switch (rotate_type)
+    {
+    case 2:
+        blit_rows(rgb, stride, rgba, outw, outh, outstride, true, false);
+        break;
+    case 3:
+        blit_rows(rgb, stride, rgba, outw, outh, outstride, true, true);
+        break;
+    case 4:
+        blit_rows(rgb, stride, rgba, outw, outh, outstride, false, true);
+        break;
+    case 5:
+        blit_columns(rgb, w, h, stride, rgba, outw, outh, outstride, false, false);
+        break;
+    case 6:
+        blit_columns(rgb, w, h, stride, rgba, outw, outh, outstride, false, true);
+        break;
+    case 7:
+        blit_columns(rgb, w, h, stride, rgba, outw, outh, outstride, true, true);
+        break;
+    case 8:
+        blit_columns(rgb, w, h, stride, rgba, outw, outh, outstride, true, false);
+        break;
+    default:
+        blit_rows(rgb, stride, rgba, outw, outh, outstride, false, false);
+        break;
+    }
+}
@@ -0,0 +1,23 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef BLIT_H
+#define BLIT_H
+
+// rotate a w x h rgb image by rotate_type (1~8, as in ncnn kanna_rotate) and expand it to opaque rgba
+// rgba is outw x outh with outstride bytes per row, typically the bits of a locked ANativeWindow_Buffer
+// same pixels as kanna_rotate_c3 followed by the rgb to rgba expansion, in one pass
+void rgb_rotate_to_rgba(const unsigned char* rgb, int w, int h, int stride, unsigned char* rgba, int outw, int outh, int outstride, int rotate_type);
+
+#endif // BLIT_H
@@ -0,0 +1,125 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "dfl.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif // __ARM_NEON
+
+// nanodet-m uses reg_max 7, larger heads stay well below this
+#define DFL_MAX_BINS 32
+
+DFLDecoder::DFLDecoder()
+{
+    reg_max_1 = 0;
+}
+
+int DFLDecoder::create(int _reg_max_1)
+{
+    if (_reg_max_1 <= 0 || _reg_max_1 > DFL_MAX_BINS)
+        return -1;
+
+    reg_max_1 = _reg_max_1;
+
+    return 0;
+}
+
+void DFLDecoder::decode(const float* dis_pred, float* pred_ltrb) const
+{
+    // bin-major layout, the 4 sides of one bin sit in adjacent lanes
+    float bins[DFL_MAX_BINS * 4];
+    for (int k = 0; k < 4; k++)
+    {
+        const float* ptr = dis_pred + k * reg_max_1;
+        for (int l = 0; l < reg_max_1; l++)
+        {
+            bins[l * 4 + k] = ptr[l];
+        }
+    }
+
+    float max[4];
+#if __ARM_NEON
+    {
+        float32x4_t _max = vld1q_f32(bins);
+        for (int l = 1; l < reg_max_1; l++)
+        {
+            _max = vmaxq_f32(_max, vld1q_f32(bins + l * 4));
+        }
+        vst1q_f32(max, _max);
+    }
+#else
+    for (int k = 0; k < 4; k++)
+    {
+        max[k] = bins[k];
+    }
+    for (int l = 1; l < reg_max_1; l++)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            max[k] = std::max(max[k], bins[l * 4 + k]);
+        }
+    }
+#endif // __ARM_NEON
+
+    for (int l = 0; l < reg_max_1; l++)
+    {
+        float* ptr = bins + l * 4;
+        ptr[0] = expf(ptr[0] - max[0]);
+        ptr[1] = expf(ptr[1] - max[1]);
+        ptr[2] = expf(ptr[2] - max[2]);
+        ptr[3] = expf(ptr[3] - max[3]);
+    }
+
+    // expectation = sum(l * e_l) / sum(e_l)
+#if __ARM_NEON
+    {
+        float32x4_t _sum = vdupq_n_f32(0.f);
+        float32x4_t _dot = vdupq_n_f32(0.f);
+        for (int l = 0; l < reg_max_1; l++)
+        {
+            float32x4_t _e = vld1q_f32(bins + l * 4);
+            _sum = vaddq_f32(_sum, _e);
+            _dot = vmlaq_n_f32(_dot, _e, (float)l);
+        }
+
+        float32x4_t _reciprocal = vrecpeq_f32(_sum);
+        _reciprocal = vmulq_f32(vrecpsq_f32(_sum, _reciprocal), _reciprocal);
+        _reciprocal = vmulq_f32(vrecpsq_f32(_sum, _reciprocal), _reciprocal);
+        vst1q_f32(pred_ltrb, vmulq_f32(_dot, _reciprocal));
+    }
+#else
+    {
+        float sum[4] = {0.f, 0.f, 0.f, 0.f};
+        float dot[4] = {0.f, 0.f, 0.f, 0.f};
+        for (int l = 0; l < reg_max_1; l++)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                sum[k] += bins[l * 4 + k];
+                dot[k] += l * bins[l * 4 + k];
+            }
+        }
+
+        for (int k = 0; k < 4; k++)
+        {
+            pred_ltrb[k] = dot[k] / sum[k];
+        }
+    }
+#endif // __ARM_NEON
+}
@@ -0,0 +1,35 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef DFL_H
+#define DFL_H
+
+// nanodet distribution focal loss box decoder
+// softmax over reg_max_1 bins followed by the expectation, for the 4 sides at once
+class DFLDecoder
+{
+public:
+    DFLDecoder();
+
+    int create(int reg_max_1);
+
+    // dis_pred holds 4 rows of reg_max_1 bins in ltrb order
+    // pred_ltrb receives the distances in grid units
+    void decode(const float* dis_pred, float* pred_ltrb) const;
+
+public:
+    int reg_max_1;
+};
+
+#endif // DFL_H
@@ -0,0 +1,220 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef HOTSWAP_H
+#define HOTSWAP_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// double buffered instance of T
+// readers grab the current instance once per frame with get() and keep it alive while they use it,
+// load_async() builds the replacement on a background thread and publishes it atomically,
+// the old instance is handed back to that thread once its last reader lets go and destroyed there,
+// so tearing down nets and mappings never stalls a frame
+template<typename T>
+class HotSwap
+{
+public:
+    // builds the replacement into instance and returns 0 to publish it, an empty instance unloads,
+    // nonzero keeps the current instance published
+    typedef std::function<int(std::shared_ptr<T>& instance)> Factory;
+
+    HotSwap()
+        : state(std::make_shared<State>())
+    {
+    }
+
+    ~HotSwap()
+    {
+        {
+            std::lock_guard<std::mutex> g(state->mutex);
+            state->quit = true;
+        }
+        state->cond.notify_all();
+
+        if (worker.joinable())
+            worker.join();
+
+        // no worker left, readers still holding an instance destroy it themselves from now on
+        std::shared_ptr<T> last = std::atomic_exchange(&current, std::shared_ptr<T>());
+        last.reset();
+
+        // and whatever the worker had not got to yet goes here
+        std::vector<std::shared_ptr<T> > retired;
+        {
+            std::lock_guard<std::mutex> g(state->mutex);
+            retired.swap(state->retired);
+        }
+    }
+
+    std::shared_ptr<T> get() const
+    {
+        return std::atomic_load(&current);
+    }
+
+    void publish(const std::shared_ptr<T>& instance)
+    {
+        // released after the lock, the previous instance may retire right away
+        std::shared_ptr<T> previous;
+
+        std::lock_guard<std::mutex> g(state->mutex);
+
+        if (instance && !worker.joinable())
+            worker = std::thread(&HotSwap::worker_loop, this);
+
+        previous = std::atomic_exchange(&current, wrap(instance));
+    }
+
+    // queue a reload, a queued one that has not started yet is superseded
+    void load_async(const Factory& factory)
+    {
+        {
+            std::lock_guard<std::mutex> g(state->mutex);
+            state->pending = factory;
+            state->has_pending = true;
+
+            if (!worker.joinable())
+                worker = std::thread(&HotSwap::worker_loop, this);
+        }
+        state->cond.notify_all();
+    }
+
+    // block until every queued reload has been published and every retired instance destroyed
+    void wait_idle()
+    {
+        std::unique_lock<std::mutex> g(state->mutex);
+        state->cond.wait(g, [this] { return (!state->has_pending && !state->busy && state->retired.empty()) || state->quit; });
+    }
+
+private:
+    struct State
+    {
+        State()
+        {
+            has_pending = false;
+            busy = false;
+            quit = false;
+        }
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        Factory pending;
+        bool has_pending;
+        bool busy;
+        bool quit;
+        // instances no reader holds any more, waiting for the worker
+        std::vector<std::shared_ptr<T> > retired;
+    };
+
+    // deleter of the published handle, runs on whichever thread drops the last reference
+    // and only queues the instance itself for the worker
+    struct Retire
+    {
+        Retire(const std::shared_ptr<State>& _state, const std::shared_ptr<T>& _instance)
+            : state(_state), instance(_instance)
+        {
+        }
+
+        void operator()(T*)
+        {
+            std::unique_lock<std::mutex> g(state->mutex);
+            if (state->quit)
+            {
+                g.unlock();
+                instance.reset();
+                return;
+            }
+
+            state->retired.push_back(instance);
+            instance.reset();
+            state->cond.notify_all();
+        }
+
+        std::shared_ptr<State> state;
+        std::shared_ptr<T> instance;
+    };
+
+    std::shared_ptr<T> wrap(const std::shared_ptr<T>& instance) const
+    {
+        if (!instance)
+            return std::shared_ptr<T>();
+
+        return std::shared_ptr<T>(instance.get(), Retire(state, instance));
+    }
+
+    void worker_loop()
+    {
+        std::unique_lock<std::mutex> g(state->mutex);
+        for (;;)
+        {
+            state->cond.wait(g, [this] { return state->has_pending || !state->retired.empty() || state->quit; });
+            if (state->quit)
+                break;
+
+            if (!state->retired.empty())
+            {
+                std::vector<std::shared_ptr<T> > retired;
+                retired.swap(state->retired);
+
+                // wait_idle() must not return while these are still being torn down
+                state->busy = true;
+
+                g.unlock();
+                retired.clear();
+                g.lock();
+
+                state->busy = false;
+                state->cond.notify_all();
+                continue;
+            }
+
+            Factory factory = state->pending;
+            state->pending = Factory();
+            state->has_pending = false;
+            state->busy = true;
+
+            g.unlock();
+            std::shared_ptr<T> instance;
+            int ret = factory(instance);
+            g.lock();
+
+            // a failed load is never published, a newer request makes this instance stale before anyone saw it
+            std::shared_ptr<T> previous;
+            if (ret == 0 && !state->has_pending)
+                previous = std::atomic_exchange(&current, wrap(instance));
+
+            // the previous handle may retire its instance, which takes the lock
+            g.unlock();
+            previous.reset();
+            instance.reset();
+            g.lock();
+
+            state->busy = false;
+            state->cond.notify_all();
+        }
+    }
+
+private:
+    std::shared_ptr<T> current;
+
+    std::shared_ptr<State> state;
+    std::thread worker;
+};
+
+#endif // HOTSWAP_H
@@ -0,0 +1,272 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "landmark.h"
+
+#include <string.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "benchmark.h"
+#include "cpu.h"
+
+#include "handroi.h"
+#include "profiler.h"
+
+
+
+int LandmarkModel::load(const char* modeltype, bool use_gpu)
+{
+    landmark.clear();
+
+    ncnn::set_cpu_powersave(2);
+    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
+
+    landmark.opt = ncnn::Option();
+
+#if NCNN_VULKAN
+    landmark.opt.use_vulkan_compute = use_gpu;
+#endif
+
+    landmark.opt.num_threads = ncnn::get_big_cpu_count();
+    // sessions bring their own blob and workspace allocators
+
+    char parampath[256];
+    char modelpath[256];
+    sprintf(parampath, "%s.param", modeltype);
+    sprintf(modelpath, "%s.bin", modeltype);
+
+    return load_mapped(landmark, parampath, modelpath, model_file);
+}
+
+#if __ANDROID_API__ >= 9
+int LandmarkModel::load(AAssetManager* mgr, const char* modeltype, bool use_gpu)
+{
+    landmark.clear();
+
+    ncnn::set_cpu_powersave(2);
+    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
+
+    landmark.opt = ncnn::Option();
+
+#if NCNN_VULKAN
+    landmark.opt.use_vulkan_compute = use_gpu;
+#endif
+
+    landmark.opt.num_threads = ncnn::get_big_cpu_count();
+    // sessions bring their own blob and workspace allocators
+
+    char parampath[256];
+    char modelpath[256];
+    sprintf(parampath, "%s.param", modeltype);
+    sprintf(modelpath, "%s.bin", modeltype);
+
+    return load_mapped(landmark, mgr, parampath, modelpath, model_file);
+}
+#endif // __ANDROID_API__ >= 9
+
+LandmarkDetect::LandmarkDetect()
+{
+    num_threads = ncnn::get_big_cpu_count();
+}
+
+int LandmarkDetect::load(const char* modeltype, bool use_gpu)
+{
+    std::shared_ptr<LandmarkModel> m = std::make_shared<LandmarkModel>();
+    int ret = m->load(modeltype, use_gpu);
+
+    set_model(m);
+
+    return ret;
+}
+
+#if __ANDROID_API__ >= 9
+int LandmarkDetect::load(AAssetManager* mgr, const char* modeltype, bool use_gpu)
+{
+    std::shared_ptr<LandmarkModel> m = std::make_shared<LandmarkModel>();
+    int ret = m->load(mgr, modeltype, use_gpu);
+
+    set_model(m);
+
+    return ret;
+}
+#endif // __ANDROID_API__ >= 9
+
+void LandmarkDetect::set_model(const std::shared_ptr<const LandmarkModel>& _model)
+{
+    model = _model;
+}
+
+void LandmarkDetect::set_num_threads(int _num_threads)
+{
+    num_threads = _num_threads;
+}
+
+float LandmarkDetect::detect(const cv::Mat& rgb, const cv::Rect& box, HandLandmarks& hand)
+{
+    const int target_size = 224;
+
+    hand.score = 0.f;
+
+    if (!model)
+        return 0.f;
+
+    if (batch.c < 3)
+    {
+        batch.create(target_size, target_size, 3);
+        if (batch.empty())
+            return 0.f;
+    }
+
+    reserve_slots(1);
+
+    ncnn::Mat in_pad = batch.channel_range(0, 3);
+    detect_one(rgb, box, in_pad, num_threads, *slots[0], hand);
+
+    end_frame(1);
+
+    return hand.score;
+}
+
+int LandmarkDetect::detect(const cv::Mat& rgb, const std::vector<cv::Rect>& boxes, std::vector<HandLandmarks>& hands)
+{
+    const int target_size = 224;
+    const int n = boxes.size();
+
+    hands.resize(n);
+    if (n == 0)
+        return 0;
+
+    if (!model)
+        return -1;
+
+    PROFILE_STAGE(STAGE_LANDMARK);
+
+    if (batch.c < n * 3)
+    {
+        batch.create(target_size, target_size, n * 3);
+        if (batch.empty())
+            return -100;
+    }
+
+    reserve_slots(n);
+
+    if (n == 1 || num_threads == 1)
+    {
+        // a single hand keeps all threads inside the net, a single thread takes the hands in turn
+        // rather than through a one thread openmp team
+        for (int i = 0; i < n; i++)
+        {
+            ncnn::Mat in_pad = batch.channel_range(i * 3, 3);
+            detect_one(rgb, boxes[i], in_pad, num_threads, *slots[i], hands[i]);
+        }
+
+        end_frame(n);
+        return 0;
+    }
+
+    // one single threaded extractor and slot per hand
+    #pragma omp parallel for num_threads(std::min(n, num_threads))
+    for (int i = 0; i < n; i++)
+    {
+        ncnn::Mat in_pad = batch.channel_range(i * 3, 3);
+        detect_one(rgb, boxes[i], in_pad, 1, *slots[i], hands[i]);
+    }
+
+    end_frame(n);
+    return 0;
+}
+
+double LandmarkDetect::warmup(int max_hands)
+{
+    // nothing loaded
+    if (!model || model->landmark.layers().empty())
+        return 0.0;
+
+    double start = ncnn::get_current_time();
+
+    const int target_size = 224;
+    cv::Mat blank = cv::Mat::zeros(target_size, target_size, CV_8UC3);
+
+    std::vector<cv::Rect> boxes;
+    std::vector<HandLandmarks> hands;
+    for (int n = 1; n <= max_hands; n++)
+    {
+        boxes.assign(n, cv::Rect(0, 0, target_size, target_size));
+        detect(blank, boxes, hands);
+    }
+
+    return ncnn::get_current_time() - start;
+}
+
+void LandmarkDetect::get_arena_usage(size_t& current_bytes, size_t& peak_bytes) const
+{
+    current_bytes = 0;
+    peak_bytes = 0;
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        current_bytes += slots[i]->blob_allocator.current_bytes() + slots[i]->workspace_allocator.current_bytes();
+        peak_bytes += slots[i]->blob_allocator.peak_bytes() + slots[i]->workspace_allocator.peak_bytes();
+    }
+}
+
+void LandmarkDetect::reserve_slots(int n)
+{
+    while ((int)slots.size() < n)
+    {
+        slots.push_back(std::make_shared<HandSlot>());
+    }
+}
+
+void LandmarkDetect::end_frame(int n)
+{
+    // detect_one released all its blobs, hand every block back at once
+    for (int i = 0; i < n; i++)
+    {
+        slots[i]->blob_allocator.reset();
+        slots[i]->workspace_allocator.reset();
+    }
+}
+
+int LandmarkDetect::detect_one(const cv::Mat& rgb, const cv::Rect& box, ncnn::Mat& in_pad, int num_threads, HandSlot& slot, HandLandmarks& hand)
+{
+    // in place, the hand region is never copied
+    float scale;
+    int wpad;
+    int hpad;
+    hand_roi_to_input(rgb.data, (int)rgb.step[0], box.x, box.y, box.width, box.height, 224, slot.resized, in_pad, scale, wpad, hpad);
+
+    ncnn::Mat points,score;
+    {
+        // the only heap allocations left in a steady state frame are the extractor and its forward pass, see benchmark/alloc.cpp
+        ncnn::Extractor ex = model->landmark.create_extractor();
+        ex.set_num_threads(num_threads);
+        ex.set_blob_allocator(&slot.blob_allocator);
+        ex.set_workspace_allocator(&slot.workspace_allocator);
+        ex.input("input", in_pad);
+        ex.extract("points", points);
+        ex.extract("score",score);
+    }
+
+    float* points_data = (float*)points.data;
+    float* score_data = (float*)score.data;
+    for (int i = 0; i < 21; i++)
+    {
+        hand.pts[i].x = (points_data[i * 3] - (wpad / 2)) / scale+(float)box.x;
+        hand.pts[i].y = (points_data[i * 3 + 1]- (hpad / 2)) / scale+(float)box.y;
+    }
+    hand.score = score_data[0];
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef LANDMARK_H
+#define LANDMARK_H
+
+#include <memory>
+
+#include <opencv2/core/core.hpp>
+#include <net.h>
+
+#include "arena.h"
+#include "modelfile.h"
+
+struct HandLandmarks
+{
+    cv::Point2f pts[21];
+    float score;
+};
+
+// param and weights of the landmark net, read only once loaded
+// any number of LandmarkDetect sessions on any threads can share one
+class LandmarkModel
+{
+public:
+    int load(const char* modeltype, bool use_gpu = false);
+
+#if __ANDROID_API__ >= 9
+    int load(AAssetManager* mgr, const char* modeltype, bool use_gpu = false);
+#endif // __ANDROID_API__ >= 9
+
+private:
+    // weights of the net point into this mapping, declared first so it outlives the net
+    MappedFile model_file;
+
+public:
+    ncnn::Net landmark;
+};
+
+// per stream state of the landmark net, one thread at a time
+class LandmarkDetect
+{
+public:
+    LandmarkDetect();
+
+    // loads a model of its own
+    int load(const char* modeltype, bool use_gpu = false);
+
+#if __ANDROID_API__ >= 9
+    int load(AAssetManager* mgr, const char* modeltype, bool use_gpu = false);
+#endif // __ANDROID_API__ >= 9
+
+    // run on a model shared with other sessions
+    void set_model(const std::shared_ptr<const LandmarkModel>& model);
+
+    // overrides the big core count picked at load
+    void set_num_threads(int num_threads);
+
+    // one hand into the first slot of the batch buffer, returns the handedness score
+    float detect(const cv::Mat& rgb, const cv::Rect& box, HandLandmarks& hand);
+
+    // all hands of a frame at once, the rois share one preallocated input buffer
+    // and run on parallel extractors, hands[i] belongs to boxes[i]
+    int detect(const cv::Mat& rgb, const std::vector<cv::Rect>& boxes, std::vector<HandLandmarks>& hands);
+
+    // run blank 224 x 224 hands through both the single and the parallel path, up to max_hands at once,
+    // so the first frames skip pipeline setup and buffer growth, returns the time spent in ms
+    double warmup(int max_hands = 2);
+
+    // bytes held by the hand slot arenas right now and at most
+    void get_arena_usage(size_t& current_bytes, size_t& peak_bytes) const;
+
+private:
+    // arenas and resize scratch of one hand slot, a slot runs on one thread at a time
+    struct HandSlot
+    {
+        ArenaAllocator blob_allocator;
+        LockedArenaAllocator workspace_allocator;
+
+        // the roi downscaled to at most 224 x 224, packed rgb
+        std::vector<unsigned char> resized;
+    };
+
+    int detect_one(const cv::Mat& rgb, const cv::Rect& box, ncnn::Mat& in_pad, int num_threads, HandSlot& slot, HandLandmarks& hand);
+
+    // at least n slots
+    void reserve_slots(int n);
+
+    // the first n slots are done with the frame, their arenas are emptied for the next one
+    void end_frame(int n);
+
+private:
+    std::shared_ptr<const LandmarkModel> model;
+    int num_threads;
+
+    // 224 x 224 x 3 per hand, grown to the largest hand count seen
+    ncnn::Mat batch;
+
+    // grown to the largest hand count seen
+    std::vector<std::shared_ptr<HandSlot> > slots;
+};
+
+#endif // LANDMARK_H
@@ -0,0 +1,331 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "letterbox.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif // __ARM_NEON
+
+static void resize_coefficients(int srcsize, int dstsize, std::vector<int>& ofs, std::vector<float>& alpha)
+{
+    ofs.resize(dstsize);
+    alpha.resize(dstsize);
+
+    const float scale = (float)srcsize / dstsize;
+    for (int i = 0; i < dstsize; i++)
+    {
+        float f = (i + 0.5f) * scale - 0.5f;
+        int s = (int)floorf(f);
+        f -= s;
+
+        if (s < 0)
+        {
+            s = 0;
+            f = 0.f;
+        }
+        if (s >= srcsize - 1)
+        {
+            s = std::max(srcsize - 2, 0);
+            f = srcsize > 1 ? 1.f : 0.f;
+        }
+
+        ofs[i] = s;
+        alpha[i] = f;
+    }
+}
+
+Letterbox::Letterbox()
+{
+    srcw = 0;
+    srch = 0;
+    w = 0;
+    h = 0;
+}
+
+void Letterbox::prepare(int _srcw, int _srch, int _w, int _h)
+{
+    if (_srcw == srcw && _srch == srch && _w == w && _h == h)
+        return;
+
+    srcw = _srcw;
+    srch = _srch;
+    w = _w;
+    h = _h;
+
+    resize_coefficients(srcw, w, xofs, alphax);
+    resize_coefficients(srch, h, yofs, alphay);
+
+    rows.resize(w * 3 * 2);
+}
+
+void Letterbox::resize_row(const unsigned char* srcptr, bool swap_rb, float* rowptr) const
+{
+    float* r0 = rowptr + (swap_rb ? w * 2 : 0);
+    float* r1 = rowptr + w;
+    float* r2 = rowptr + (swap_rb ? 0 : w * 2);
+
+    // a single source column has no right neighbour
+    const int next = srcw > 1 ? 3 : 0;
+
+    for (int x = 0; x < w; x++)
+    {
+        const unsigned char* p = srcptr + xofs[x] * 3;
+        const float a1 = alphax[x];
+        const float a0 = 1.f - a1;
+
+        r0[x] = p[0] * a0 + p[next + 0] * a1;
+        r1[x] = p[1] * a0 + p[next + 1] * a1;
+        r2[x] = p[2] * a0 + p[next + 2] * a1;
+    }
+}
+
+int Letterbox::resize(const unsigned char* pixels, int _srcw, int _srch, int srcstride, bool swap_rb,
+                      int _w, int _h, int left, int top, int target_w, int target_h, float pad_value,
+                      const float* mean_vals, const float* norm_vals, ncnn::Mat& out)
+{
+    if (_w <= 0 || _h <= 0 || left < 0 || top < 0 || left + _w > target_w || top + _h > target_h)
+        return -1;
+
+    prepare(_srcw, _srch, _w, _h);
+
+    // no-op when the tensor from the previous frame already has this shape
+    out.create(target_w, target_h, 3, 4u);
+    if (out.empty())
+        return -100;
+
+    float* rows0 = &rows[0];
+    float* rows1 = &rows[w * 3];
+    int prev_sy = -2;
+
+    const int next_row = srch > 1 ? 1 : 0;
+
+    for (int y = 0; y < target_h; y++)
+    {
+        const int dy = y - top;
+        const bool inside = dy >= 0 && dy < h;
+
+        if (inside)
+        {
+            const int sy = yofs[dy];
+            if (sy == prev_sy + 1)
+            {
+                std::swap(rows0, rows1);
+                resize_row(pixels + (sy + next_row) * srcstride, swap_rb, rows1);
+            }
+            else if (sy != prev_sy)
+            {
+                resize_row(pixels + sy * srcstride, swap_rb, rows0);
+                resize_row(pixels + (sy + next_row) * srcstride, swap_rb, rows1);
+            }
+            prev_sy = sy;
+        }
+
+        for (int q = 0; q < 3; q++)
+        {
+            const float mean = mean_vals ? mean_vals[q] : 0.f;
+            const float norm = norm_vals ? norm_vals[q] : 1.f;
+            const float border = (pad_value - mean) * norm;
+
+            float* outptr = out.channel(q).row(y);
+
+            if (!inside)
+            {
+                for (int x = 0; x < target_w; x++)
+                {
+                    outptr[x] = border;
+                }
+                continue;
+            }
+
+            for (int x = 0; x < left; x++)
+            {
+                outptr[x] = border;
+            }
+            for (int x = left + w; x < target_w; x++)
+            {
+                outptr[x] = border;
+            }
+
+            const float b1 = alphay[dy];
+            const float b0 = 1.f - b1;
+            const float* p0 = rows0 + w * q;
+            const float* p1 = rows1 + w * q;
+            float* ptr = outptr + left;
+
+            int x = 0;
+#if __ARM_NEON
+            float32x4_t _b0 = vdupq_n_f32(b0);
+            float32x4_t _b1 = vdupq_n_f32(b1);
+            float32x4_t _mean = vdupq_n_f32(mean);
+            float32x4_t _norm = vdupq_n_f32(norm);
+            for (; x + 3 < w; x += 4)
+            {
+                float32x4_t _v = vmulq_f32(vld1q_f32(p0 + x), _b0);
+                _v = vmlaq_f32(_v, vld1q_f32(p1 + x), _b1);
+                _v = vmulq_f32(vsubq_f32(_v, _mean), _norm);
+                vst1q_f32(ptr + x, _v);
+            }
+#endif // __ARM_NEON
+            for (; x < w; x++)
+            {
+                float v = p0[x] * b0 + p1[x] * b1;
+                ptr[x] = (v - mean) * norm;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// bilinear taps of one output axis on one source axis of srcsize samples starting at origin
+// flip walks the source axis backwards, luma_step and chroma_step are 1 and 2 for columns,
+// nv21_width for rows
+void Letterbox::nv21_taps(int dstsize, int srcsize, bool flip, int origin, int luma_step, int chroma_step, std::vector<Nv21Tap>& taps)
+{
+    taps.resize(dstsize);
+
+    const float scale = (float)srcsize / dstsize;
+    for (int i = 0; i < dstsize; i++)
+    {
+        float f = std::min(std::max((i + 0.5f) * scale - 0.5f, 0.f), (float)(srcsize - 1));
+        if (flip)
+            f = srcsize - 1 - f;
+
+        const int s0 = std::min((int)f, srcsize - 1);
+        const int s1 = std::min(s0 + 1, srcsize - 1);
+
+        Nv21Tap& tap = taps[i];
+        tap.ofs0 = (origin + s0) * luma_step;
+        tap.ofs1 = (origin + s1) * luma_step;
+        tap.alpha = f - s0;
+        // chroma from the absolute position, an odd roi origin starts mid 2x2 block
+        tap.chroma_ofs = (origin + s0) / 2 * chroma_step;
+    }
+}
+
+int Letterbox::resize_nv21(const unsigned char* nv21, int nv21_width, int nv21_height,
+                           int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, bool swap_rb,
+                           int _w, int _h, int left, int top, int target_w, int target_h, float pad_value,
+                           const float* mean_vals, const float* norm_vals, ncnn::Mat& out)
+{
+    if (_w <= 0 || _h <= 0 || left < 0 || top < 0 || left + _w > target_w || top + _h > target_h)
+        return -1;
+
+    out.create(target_w, target_h, 3, 4u);
+    if (out.empty())
+        return -100;
+
+    // rotate_type follows kanna_rotate, 5~8 transpose so output columns walk source rows
+    const bool transpose = rotate_type >= 5;
+    const bool flip_col = transpose ? rotate_type == 6 || rotate_type == 7 : rotate_type == 2 || rotate_type == 3;
+    const bool flip_row = transpose ? rotate_type == 7 || rotate_type == 8 : rotate_type == 3 || rotate_type == 4;
+    if (transpose)
+    {
+        nv21_taps(_w, roi_h, flip_col, roi_y, nv21_width, nv21_width, nv21_col_taps);
+        nv21_taps(_h, roi_w, flip_row, roi_x, 1, 2, nv21_row_taps);
+    }
+    else
+    {
+        nv21_taps(_w, roi_w, flip_col, roi_x, 1, 2, nv21_col_taps);
+        nv21_taps(_h, roi_h, flip_row, roi_y, nv21_width, nv21_width, nv21_row_taps);
+    }
+
+    const unsigned char* yptr = nv21;
+    const unsigned char* vuptr = nv21 + nv21_width * nv21_height;
+
+    const int c0 = swap_rb ? 2 : 0;
+    const int c2 = swap_rb ? 0 : 2;
+
+    float mean[3];
+    float norm[3];
+    float border[3];
+    for (int q = 0; q < 3; q++)
+    {
+        mean[q] = mean_vals ? mean_vals[q] : 0.f;
+        norm[q] = norm_vals ? norm_vals[q] : 1.f;
+        border[q] = (pad_value - mean[q]) * norm[q];
+    }
+
+    for (int y = 0; y < target_h; y++)
+    {
+        float* outptr0 = out.channel(c0).row(y);
+        float* outptr1 = out.channel(1).row(y);
+        float* outptr2 = out.channel(c2).row(y);
+
+        const int dy = y - top;
+        if (dy < 0 || dy >= _h)
+        {
+            for (int x = 0; x < target_w; x++)
+            {
+                outptr0[x] = border[c0];
+                outptr1[x] = border[1];
+                outptr2[x] = border[c2];
+            }
+            continue;
+        }
+
+        for (int x = 0; x < left; x++)
+        {
+            outptr0[x] = border[c0];
+            outptr1[x] = border[1];
+            outptr2[x] = border[c2];
+        }
+        for (int x = left + _w; x < target_w; x++)
+        {
+            outptr0[x] = border[c0];
+            outptr1[x] = border[1];
+            outptr2[x] = border[c2];
+        }
+
+        const Nv21Tap& row_tap = nv21_row_taps[dy];
+
+        for (int dx = 0; dx < _w; dx++)
+        {
+            const Nv21Tap& col_tap = nv21_col_taps[dx];
+
+            // the source x tap is interpolated first either way
+            const Nv21Tap& xt = transpose ? row_tap : col_tap;
+            const Nv21Tap& yt = transpose ? col_tap : row_tap;
+
+            // bilinear luma
+            const unsigned char* y0ptr = yptr + yt.ofs0;
+            const unsigned char* y1ptr = yptr + yt.ofs1;
+            const float yy0 = y0ptr[xt.ofs0] + (y0ptr[xt.ofs1] - y0ptr[xt.ofs0]) * xt.alpha;
+            const float yy1 = y1ptr[xt.ofs0] + (y1ptr[xt.ofs1] - y1ptr[xt.ofs0]) * xt.alpha;
+            const float yy = yy0 + (yy1 - yy0) * yt.alpha;
+
+            // nearest chroma on the half resolution plane
+            const unsigned char* vu = vuptr + yt.chroma_ofs + xt.chroma_ofs;
+            const float v = vu[0] - 128.f;
+            const float u = vu[1] - 128.f;
+
+            // same coefficients as ncnn::yuv420sp2rgb
+            const float r = std::min(std::max(yy + 1.370705f * v, 0.f), 255.f);
+            const float g = std::min(std::max(yy - 0.698001f * v - 0.337633f * u, 0.f), 255.f);
+            const float b = std::min(std::max(yy + 1.732446f * u, 0.f), 255.f);
+
+            const int x = left + dx;
+            outptr0[x] = (r - mean[c0]) * norm[c0];
+            outptr1[x] = (g - mean[1]) * norm[1];
+            outptr2[x] = (b - mean[c2]) * norm[c2];
+        }
+    }
+
+    return 0;
+}
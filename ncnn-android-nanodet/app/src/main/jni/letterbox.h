@@ -0,0 +1,82 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef LETTERBOX_H
+#define LETTERBOX_H
+
+#include <vector>
+
+#include <mat.h>
+
+// fused letterbox preprocess
+// bilinear resize of packed 3 channel pixels, constant border and mean/norm in one pass
+// straight into a planar float tensor that is kept across frames
+class Letterbox
+{
+public:
+    Letterbox();
+
+    // the w x h resized image lands at (left, top) inside a target_w x target_h x 3 tensor
+    // swap_rb writes the channels in reversed order, like PIXEL_RGB2BGR
+    // border pixels get pad_value before mean/norm, mean_vals and norm_vals may be null
+    int resize(const unsigned char* pixels, int srcw, int srch, int srcstride, bool swap_rb,
+               int w, int h, int left, int top, int target_w, int target_h, float pad_value,
+               const float* mean_vals, const float* norm_vals, ncnn::Mat& out);
+
+    // same, but samples a roi of a camera nv21 frame and converts to rgb on the fly
+    // roi is in nv21 coordinates, rotate_type 1~8 is applied before resizing to w x h
+    int resize_nv21(const unsigned char* nv21, int nv21_width, int nv21_height,
+                    int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, bool swap_rb,
+                    int w, int h, int left, int top, int target_w, int target_h, float pad_value,
+                    const float* mean_vals, const float* norm_vals, ncnn::Mat& out);
+
+private:
+    void prepare(int srcw, int srch, int w, int h);
+
+    void resize_row(const unsigned char* srcptr, bool swap_rb, float* rowptr) const;
+
+private:
+    // one output column or row of resize_nv21, as byte offsets into the nv21 frame
+    // luma rows carry the nv21_width multiple, so a pixel address is a row tap plus a column tap
+    struct Nv21Tap
+    {
+        int ofs0;
+        int ofs1;
+        float alpha;
+        // nearest chroma sample of ofs0 in the interleaved vu plane
+        int chroma_ofs;
+    };
+
+    static void nv21_taps(int dstsize, int srcsize, bool flip, int origin, int luma_step, int chroma_step, std::vector<Nv21Tap>& taps);
+
+private:
+    // bilinear tables, rebuilt only when the resize geometry changes
+    int srcw;
+    int srch;
+    int w;
+    int h;
+    std::vector<int> xofs;
+    std::vector<float> alphax;
+    std::vector<int> yofs;
+    std::vector<float> alphay;
+
+    // two horizontally resized source rows, 3 planes of w each
+    std::vector<float> rows;
+
+    // rotation already folded in, rebuilt on every resize_nv21 call
+    std::vector<Nv21Tap> nv21_col_taps;
+    std::vector<Nv21Tap> nv21_row_taps;
+};
+
+#endif // LETTERBOX_H
@@ -17,95 +17,27 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "benchmark.h"
 #include "cpu.h"
 
+#include "profiler.h"
 
-static inline float intersection_area(const Object& a, const Object& b)
-{
-    cv::Rect_<float> inter = a.rect & b.rect;
-    return inter.area();
-}
-
-static void qsort_descent_inplace(std::vector<Object>& faceobjects, int left, int right)
-{
-    int i = left;
-    int j = right;
-    float p = faceobjects[(left + right) / 2].prob;
-
-    while (i <= j)
-    {
-        while (faceobjects[i].prob > p)
-            i++;
-
-        while (faceobjects[j].prob < p)
-            j--;
-
-        if (i <= j)
-        {
-            // swap
-            std::swap(faceobjects[i], faceobjects[j]);
-
-            i++;
-            j--;
-        }
-    }
-
-    //     #pragma omp parallel sections
-    {
-        //         #pragma omp section
-        {
-            if (left < j) qsort_descent_inplace(faceobjects, left, j);
-        }
-        //         #pragma omp section
-        {
-            if (i < right) qsort_descent_inplace(faceobjects, i, right);
-        }
-    }
-}
 
-static void qsort_descent_inplace(std::vector<Object>& faceobjects)
+static void nms_bboxes(const std::vector<Object>& objects, std::vector<int>& picked, float nms_threshold, BoxNms& nms)
 {
-    if (faceobjects.empty())
-        return;
-
-    qsort_descent_inplace(faceobjects, 0, faceobjects.size() - 1);
-}
-
-static void nms_sorted_bboxes(const std::vector<Object>& faceobjects, std::vector<int>& picked, float nms_threshold)
-{
-    picked.clear();
-
-    const int n = faceobjects.size();
-
-    std::vector<float> areas(n);
-    for (int i = 0; i < n; i++)
+    nms.clear();
+    for (size_t i = 0; i < objects.size(); i++)
     {
-        areas[i] = faceobjects[i].rect.width * faceobjects[i].rect.height;
+        const cv::Rect_<float>& rect = objects[i].rect;
+        nms.push_back(rect.x, rect.y, rect.width, rect.height, objects[i].prob);
     }
 
-    for (int i = 0; i < n; i++)
-    {
-        const Object& a = faceobjects[i];
-
-        int keep = 1;
-        for (int j = 0; j < (int)picked.size(); j++)
-        {
-            const Object& b = faceobjects[picked[j]];
-
-            // intersection over union
-            float inter_area = intersection_area(a, b);
-            float union_area = areas[i] + areas[picked[j]] - inter_area;
-            // float IoU = inter_area / union_area
-            if (inter_area / union_area > nms_threshold)
-                keep = 0;
-        }
-
-        if (keep)
-            picked.push_back(i);
-    }
+    // ordering only touches (score, index) pairs, the top 300 are selected without a full sort
+    // a hand is covered by far fewer boxes than this, the cap only bounds pathological frames
+    nms.run(picked, nms_threshold, 300);
 }
 
-static void generate_proposals(const ncnn::Mat& cls_pred, const ncnn::Mat& dis_pred, int stride, const ncnn::Mat& in_pad, float prob_threshold, std::vector<Object>& objects)
+static void generate_proposals(const ncnn::Mat& cls_pred, const ncnn::Mat& dis_pred, int stride, const ncnn::Mat& in_pad, float prob_threshold, DFLDecoder& dfl, std::vector<Object>& objects)
 {
 
     const int num_grid = cls_pred.h;
@@ -125,8 +57,15 @@ static void generate_proposals(const ncnn::Mat& cls_pred, const ncnn::Mat& dis_p
 
     const int num_class = cls_pred.w;
     const int reg_max_1 = dis_pred.w / 4;
+    if (reg_max_1 != dfl.reg_max_1)
+    {
+        // head differs from the one assumed at load time
+        if (dfl.create(reg_max_1) != 0)
+            return;
+    }
     //__android_log_print(ANDROID_LOG_WARN, "ncnn","cls_pred h %d, w %d",cls_pred.h,cls_pred.w);
     //__android_log_print(ANDROID_LOG_WARN, "ncnn","%d,%d,%d,%d",num_grid_x,num_grid_y,num_class,reg_max_1);
+
     for (int i = 0; i < num_grid_y; i++)
     {
         for (int j = 0; j < num_grid_x; j++)
@@ -149,40 +88,13 @@ static void generate_proposals(const ncnn::Mat& cls_pred, const ncnn::Mat& dis_p
 
             if (score >= prob_threshold)
             {
-                ncnn::Mat bbox_pred(reg_max_1, 4, (void*)dis_pred.row(idx));
-                {
-                    ncnn::Layer* softmax = ncnn::create_layer("Softmax");
-
-                    ncnn::ParamDict pd;
-                    pd.set(0, 1); // axis
-                    pd.set(1, 1);
-                    softmax->load_param(pd);
-
-                    ncnn::Option opt;
-                    opt.num_threads = 1;
-                    opt.use_packing_layout = false;
-
-                    softmax->create_pipeline(opt);
-
-                    softmax->forward_inplace(bbox_pred, opt);
-
-                    softmax->destroy_pipeline(opt);
-
-                    delete softmax;
-                }
-
                 float pred_ltrb[4];
-                for (int k = 0; k < 4; k++)
-                {
-                    float dis = 0.f;
-                    const float* dis_after_sm = bbox_pred.row(k);
-                    for (int l = 0; l < reg_max_1; l++)
-                    {
-                        dis += l * dis_after_sm[l];
-                    }
-
-                    pred_ltrb[k] = dis * stride;
-                }
+                dfl.decode(dis_pred.row(idx), pred_ltrb);
+
+                pred_ltrb[0] *= stride;
+                pred_ltrb[1] *= stride;
+                pred_ltrb[2] *= stride;
+                pred_ltrb[3] *= stride;
 
                 float pb_cx = (j + 0.5f) * stride;
                 float pb_cy = (i + 0.5f) * stride;
@@ -208,15 +120,13 @@ static void generate_proposals(const ncnn::Mat& cls_pred, const ncnn::Mat& dis_p
 
 NanoDet::NanoDet()
 {
-    blob_pool_allocator.set_size_compare_ratio(0.f);
-    workspace_pool_allocator.set_size_compare_ratio(0.f);
+    num_threads = ncnn::get_big_cpu_count();
+    target_size = 0;
 }
 
-int NanoDet::load(const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
+int NanoDetModel::load(const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
 {
     nanodet.clear();
-    blob_pool_allocator.clear();
-    workspace_pool_allocator.clear();
 
     ncnn::set_cpu_powersave(2);
     ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
@@ -228,16 +138,21 @@ int NanoDet::load(const char* modeltype, int _target_size, const float* _mean_va
 #endif
 
     nanodet.opt.num_threads = ncnn::get_big_cpu_count();
-    nanodet.opt.blob_allocator = &blob_pool_allocator;
-    nanodet.opt.workspace_allocator = &workspace_pool_allocator;
+    // sessions bring their own blob and workspace allocators
 
     char parampath[256];
     char modelpath[256];
     sprintf(parampath, "nanodet-%s.param", modeltype);
     sprintf(modelpath, "nanodet-%s.bin", modeltype);
 
-    nanodet.load_param(parampath);
-    nanodet.load_model(modelpath);
+    int ret = load_mapped(nanodet, parampath, modelpath, model_file);
+    if (ret != 0)
+        return ret;
+
+    landmark = std::make_shared<LandmarkModel>();
+    ret = landmark->load("hand_lite-op", use_gpu);
+    if (ret != 0)
+        return ret;
 
     target_size = _target_size;
     mean_vals[0] = _mean_vals[0];
@@ -250,41 +165,37 @@ int NanoDet::load(const char* modeltype, int _target_size, const float* _mean_va
     return 0;
 }
 
-int NanoDet::load(AAssetManager* mgr, const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
+#if __ANDROID_API__ >= 9
+int NanoDetModel::load(AAssetManager* mgr, const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
 {
     __android_log_print(ANDROID_LOG_WARN, "ncnn", "load %s", modeltype);
     nanodet.clear();
-    blob_pool_allocator.clear();
-    workspace_pool_allocator.clear();
 
     ncnn::set_cpu_powersave(2);
     ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
 
     nanodet.opt = ncnn::Option();
-    handpt.opt = ncnn::Option();
 
 #if NCNN_VULKAN
     nanodet.opt.use_vulkan_compute = use_gpu;
-    handpt.opt.use_vulkan_compute = use_gpu;
 #endif
 
     nanodet.opt.num_threads = ncnn::get_big_cpu_count();
-    nanodet.opt.blob_allocator = &blob_pool_allocator;
-    nanodet.opt.workspace_allocator = &workspace_pool_allocator;
-
-    handpt.opt.num_threads = ncnn::get_big_cpu_count();
-    handpt.opt.blob_allocator = &blob_pool_allocator;
-    handpt.opt.workspace_allocator = &workspace_pool_allocator;
+    // sessions bring their own blob and workspace allocators
 
     char parampath[256];
     char modelpath[256];
     sprintf(parampath, "nanodet-%s.param", modeltype);
     sprintf(modelpath, "nanodet-%s.bin", modeltype);
     //__android_log_print(ANDROID_LOG_WARN, "ncnn", "load %s,%s", parampath,modelpath);
-    nanodet.load_param(mgr, parampath);
-    nanodet.load_model(mgr, modelpath);
-    handpt.load_param(mgr,"hand_lite-op.param");
-    handpt.load_model(mgr,"hand_lite-op.bin");
+    int ret = load_mapped(nanodet, mgr, parampath, modelpath, model_file);
+    if (ret != 0)
+        return ret;
+
+    landmark = std::make_shared<LandmarkModel>();
+    ret = landmark->load(mgr, "hand_lite-op", use_gpu);
+    if (ret != 0)
+        return ret;
 
     target_size = _target_size;
     mean_vals[0] = _mean_vals[0];
@@ -296,16 +207,72 @@ int NanoDet::load(AAssetManager* mgr, const char* modeltype, int _target_size, c
 
     return 0;
 }
+#endif // __ANDROID_API__ >= 9
 
-int NanoDet::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+int NanoDet::load(const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
 {
-    int width = rgb.cols;
-    int height = rgb.rows;
+    std::shared_ptr<NanoDetModel> m = std::make_shared<NanoDetModel>();
+    int ret = m->load(modeltype, _target_size, _mean_vals, _norm_vals, use_gpu);
+
+    set_model(m);
+
+    return ret;
+}
+
+#if __ANDROID_API__ >= 9
+int NanoDet::load(AAssetManager* mgr, const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
+{
+    std::shared_ptr<NanoDetModel> m = std::make_shared<NanoDetModel>();
+    int ret = m->load(mgr, modeltype, _target_size, _mean_vals, _norm_vals, use_gpu);
+
+    set_model(m);
+
+    return ret;
+}
+#endif // __ANDROID_API__ >= 9
+
+void NanoDet::set_model(const std::shared_ptr<const NanoDetModel>& _model)
+{
+    model = _model;
+    landmark.set_model(model->landmark);
+
+    // nanodet-m reg_max 7
+    dfl.create(8);
+
+    tracker.reset();
+
+    target_size = model->target_size;
+    mean_vals[0] = model->mean_vals[0];
+    mean_vals[1] = model->mean_vals[1];
+    mean_vals[2] = model->mean_vals[2];
+    norm_vals[0] = model->norm_vals[0];
+    norm_vals[1] = model->norm_vals[1];
+    norm_vals[2] = model->norm_vals[2];
+}
+
+double NanoDet::warmup()
+{
+    double start = ncnn::get_current_time();
+
+    // every frame is letterboxed into target_size x target_size, so this one shape
+    // creates the pipelines and grows the arenas to what every later frame needs
+    cv::Mat blank = cv::Mat::zeros(target_size, target_size, CV_8UC3);
+    std::vector<Object> objects;
+    detect(blank, objects);
+
+    landmark.warmup();
+
+    // forget whatever the blank frame left in the tracker
+    tracker.reset();
 
-    // pad to multiple of 32
-    int w = width;
-    int h = height;
-    float scale = 1.f;
+    return ncnn::get_current_time() - start;
+}
+
+static void letterbox_size(int img_w, int img_h, int target_size, int& w, int& h, float& scale)
+{
+    w = img_w;
+    h = img_h;
+    scale = 1.f;
     if (w > h)
     {
         scale = (float)target_size / w;
@@ -318,172 +285,262 @@ int NanoDet::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob
         h = target_size;
         w = w * scale;
     }
+}
 
-    ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB2BGR, width, height, w, h);
+int NanoDet::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    int width = rgb.cols;
+    int height = rgb.rows;
+
+    int w;
+    int h;
+    float scale;
+    letterbox_size(width, height, target_size, w, h, scale);
 
     // pad to target_size rectangle
-    int wpad = 320-w;//(w + 31) / 32 * 32 - w;
-    int hpad = 320-h;//(h + 31) / 32 * 32 - h;
-    ncnn::Mat in_pad;
-    ncnn::copy_make_border(in, in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 0.f);
+    int wpad = target_size - w;//(w + 31) / 32 * 32 - w;
+    int hpad = target_size - h;//(h + 31) / 32 * 32 - h;
 
-    in_pad.substract_mean_normalize(mean_vals, norm_vals);
+    // rgb2bgr resize, zero border and mean/norm in one pass into the reused in_pad
+    {
+        PROFILE_STAGE(STAGE_PREPROCESS);
+        int ret = letterbox.resize(rgb.data, width, height, (int)rgb.step[0], true, w, h, wpad / 2, hpad / 2, target_size, target_size, 0.f, mean_vals, norm_vals, in_pad);
+        if (ret != 0)
+        {
+            objects.clear();
+            return -100;
+        }
+    }
 
-    ncnn::Extractor ex = nanodet.create_extractor();
-    //__android_log_print(ANDROID_LOG_WARN, "ncnn","input w:%d,h:%d",in_pad.w,in_pad.h);
-    ex.input("input.1", in_pad);
+    detect_boxes(width, height, scale, wpad / 2, hpad / 2, objects, prob_threshold, nms_threshold);
 
-    std::vector<Object> proposals;
+    return detect_landmarks(rgb, objects);
+}
 
-    // stride 8
-    {
-        ncnn::Mat cls_pred;
-        ncnn::Mat dis_pred;
-        ex.extract("cls_pred_stride_8", cls_pred);
-        ex.extract("dis_pred_stride_8", dis_pred);
+int NanoDet::detect(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    // image size after crop and rotate
+    int img_w = rotate_type <= 4 ? roi_w : roi_h;
+    int img_h = rotate_type <= 4 ? roi_h : roi_w;
 
-        std::vector<Object> objects8;
-        generate_proposals(cls_pred, dis_pred, 8, in_pad, prob_threshold, objects8);
+    int w;
+    int h;
+    float scale;
+    letterbox_size(img_w, img_h, target_size, w, h, scale);
 
-        proposals.insert(proposals.end(), objects8.begin(), objects8.end());
-    }
+    int wpad = target_size - w;
+    int hpad = target_size - h;
 
-    // stride 16
+    // crop, rotate, yuv2bgr and resize while sampling, no full resolution rgb frame involved
     {
-        ncnn::Mat cls_pred;
-        ncnn::Mat dis_pred;
-        ex.extract("cls_pred_stride_16", cls_pred);
-        ex.extract("dis_pred_stride_16", dis_pred);
+        PROFILE_STAGE(STAGE_PREPROCESS);
+        int ret = letterbox.resize_nv21(nv21, nv21_width, nv21_height, roi_x, roi_y, roi_w, roi_h, rotate_type, true, w, h, wpad / 2, hpad / 2, target_size, target_size, 0.f, mean_vals, norm_vals, in_pad);
+        if (ret != 0)
+        {
+            objects.clear();
+            return -100;
+        }
+    }
 
-        std::vector<Object> objects16;
-        generate_proposals(cls_pred, dis_pred, 16, in_pad, prob_threshold, objects16);
+    return detect_boxes(img_w, img_h, scale, wpad / 2, hpad / 2, objects, prob_threshold, nms_threshold);
+}
 
-        proposals.insert(proposals.end(), objects16.begin(), objects16.end());
+int NanoDet::detect_boxes(int img_w, int img_h, float scale, int left, int top, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    // all outputs first so the net and the decoding show up as separate stages
+    ncnn::Mat cls_pred[3];
+    ncnn::Mat dis_pred[3];
+    {
+        PROFILE_STAGE(STAGE_INFERENCE);
+
+        // the only heap allocations left in a steady state frame are the extractor and its forward pass, see benchmark/alloc.cpp
+        ncnn::Extractor ex = model->nanodet.create_extractor();
+        ex.set_num_threads(num_threads);
+        ex.set_blob_allocator(&blob_allocator);
+        ex.set_workspace_allocator(&workspace_allocator);
+        //__android_log_print(ANDROID_LOG_WARN, "ncnn","input w:%d,h:%d",in_pad.w,in_pad.h);
+        ex.input("input.1", in_pad);
+
+        ex.extract("cls_pred_stride_8", cls_pred[0]);
+        ex.extract("dis_pred_stride_8", dis_pred[0]);
+        ex.extract("cls_pred_stride_16", cls_pred[1]);
+        ex.extract("dis_pred_stride_16", dis_pred[1]);
+        ex.extract("cls_pred_stride_32", cls_pred[2]);
+        ex.extract("dis_pred_stride_32", dis_pred[2]);
     }
 
-    // stride 32
+    proposals.clear();
     {
-        ncnn::Mat cls_pred;
-        ncnn::Mat dis_pred;
-        ex.extract("cls_pred_stride_32", cls_pred);
-        ex.extract("dis_pred_stride_32", dis_pred);
-
-        std::vector<Object> objects32;
-        generate_proposals(cls_pred, dis_pred, 32, in_pad, prob_threshold, objects32);
+        PROFILE_STAGE(STAGE_DECODE);
 
-        proposals.insert(proposals.end(), objects32.begin(), objects32.end());
+        // stride 8, 16 and 32, appended straight into proposals
+        const int strides[3] = {8, 16, 32};
+        for (int i = 0; i < 3; i++)
+        {
+            generate_proposals(cls_pred[i], dis_pred[i], strides[i], in_pad, prob_threshold, dfl, proposals);
+        }
     }
 
-    // sort all proposals by score from highest to lowest
-    qsort_descent_inplace(proposals);
+    // every blob of this frame is released, hand all blocks back at once
+    // so the arenas are merged and ready before the next frame
+    for (int i = 0; i < 3; i++)
+    {
+        cls_pred[i].release();
+        dis_pred[i].release();
+    }
+    blob_allocator.reset();
+    workspace_allocator.reset();
 
-    // apply nms with nms_threshold
-    std::vector<int> picked;
-    nms_sorted_bboxes(proposals, picked, nms_threshold);
+    // pick proposals from highest to lowest score and apply nms with nms_threshold
+    {
+        PROFILE_STAGE(STAGE_NMS);
+        nms_bboxes(proposals, picked, nms_threshold, nms);
+    }
 
     int count = picked.size();
 
     objects.resize(count);
-
     for (int i = 0; i < count; i++)
     {
         objects[i] = proposals[picked[i]];
 
         // adjust offset to original unpadded
-        float x0 = (objects[i].rect.x - (wpad / 2)) / scale;
-        float y0 = (objects[i].rect.y - (hpad / 2)) / scale;
-        float x1 = (objects[i].rect.x + objects[i].rect.width - (wpad / 2)) / scale;
-        float y1 = (objects[i].rect.y + objects[i].rect.height - (hpad / 2)) / scale;
+        float x0 = (objects[i].rect.x - left) / scale;
+        float y0 = (objects[i].rect.y - top) / scale;
+        float x1 = (objects[i].rect.x + objects[i].rect.width - left) / scale;
+        float y1 = (objects[i].rect.y + objects[i].rect.height - top) / scale;
 
         // clip
-        x0 = std::max(std::min(x0, (float)(width - 1)), 0.f);
-        y0 = std::max(std::min(y0, (float)(height - 1)), 0.f);
-        x1 = std::max(std::min(x1, (float)(width - 1)), 0.f);
-        y1 = std::max(std::min(y1, (float)(height - 1)), 0.f);
+        x0 = std::max(std::min(x0, (float)(img_w - 1)), 0.f);
+        y0 = std::max(std::min(y0, (float)(img_h - 1)), 0.f);
+        x1 = std::max(std::min(x1, (float)(img_w - 1)), 0.f);
+        y1 = std::max(std::min(y1, (float)(img_h - 1)), 0.f);
 
         objects[i].rect.x = x0;
         objects[i].rect.y = y0;
         objects[i].rect.width = x1 - x0;
         objects[i].rect.height = y1 - y0;
+        objects[i].track_confidence = 0.f;
+    }
 
+    // sort objects by area
+    struct
+    {
+        bool operator()(const Object& a, const Object& b) const
         {
-            int xx = x0;
-            int yy = y0;
-            int ww = x1-x0;
-            int hh = y1-y0;
-            //__android_log_print(ANDROID_LOG_WARN, "ncnn","rect :%f,%f,%f,%f",objects[i].rect.x,objects[i].rect.y,objects[i].rect.width,objects[i].rect.height);
-
-            //detect pts
-            //pfld
-            /*
-            cv::Mat roi_image = rgb(cv::Rect(xx,yy,ww,hh)).clone();
-            ncnn::Mat ncnn_in = ncnn::Mat::from_pixels_resize(roi_image.data,ncnn::Mat::PIXEL_RGB2BGR, roi_image.cols, roi_image.rows,224,224);
-            ncnn_in.substract_mean_normalize(meanVals, normVals);
-            ncnn::Extractor ex1 = handpt.create_extractor();
-            ex1.input("input", ncnn_in);
-            ncnn::Mat ncnn_out;
-            ex1.extract("output", ncnn_out);
-            for (int c = 0; c < ncnn_out.c; c++)
-            {
-                ncnn::Mat data = ncnn_out.channel(c);
-                const float *ptr = data.row(0);
-                for (size_t j = 0; j < 21; j++)
-                {
-                    float pt_x = ptr[j * 2] * roi_image.cols;
-                    float pt_y = ptr[j * 2 + 1] * roi_image.rows;
-                    objects[i].pts.push_back(cv::Point2f(pt_x + objects[i].rect.x, pt_y + objects[i].rect.y));
+            return a.rect.area() > b.rect.area();
+        }
+    } objects_area_greater;
+    std::sort(objects.begin(), objects.end(), objects_area_greater);
 
-                }
-            }
-            */
-            cv::Mat input = rgb(cv::Rect(xx,yy,ww,hh)).clone();
-            int target_size = 224;
-            int w = input.cols;
-            int h = input.rows;
-            float scale = 1.f;
-            if (w > h)
-            {
-                scale = (float)target_size / w;
-                w = target_size;
-                h = h * scale;
-            }
-            else
-            {
-                scale = (float)target_size / h;
-                h = target_size;
-                w = w * scale;
-            }
+    return 0;
+}
 
-            ncnn::Mat in = ncnn::Mat::from_pixels_resize(input.data, ncnn::Mat::PIXEL_RGB, input.cols, input.rows, w, h);
-            int wpad = target_size - w;
-            int hpad = target_size - h;
-            ncnn::Mat in_pad;
-            ncnn::copy_make_border(in, in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 0.f);
+int NanoDet::detect_landmarks(const cv::Mat& rgb, std::vector<Object>& objects)
+{
+    hand_boxes.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        const cv::Rect_<float>& rect = objects[i].rect;
 
-            const float norm_vals[3] = { 1 / 255.f, 1 / 255.f, 1 / 255.f };
-            in_pad.substract_mean_normalize(0, norm_vals);
-            ncnn::Mat points,score;
-            {
-                ncnn::Extractor ex = handpt.create_extractor();
-                ex.input("input", in_pad);
-                ex.extract("points", points);
-                ex.extract("score",score);
-            }
+        // landmark roi, truncated to whole pixels
+        hand_boxes[i] = cv::Rect((int)rect.x, (int)rect.y, (int)rect.width, (int)rect.height);
+    }
 
-            float* points_data = (float*)points.data;
+    // detect pts of every hand in one batched call
+    landmark.detect(rgb, hand_boxes, hands);
 
-            for (int j = 0; j < 21; j++)
-            {
-                cv::Point2f pt;
-                pt.x = (points_data[j * 3] - (wpad / 2)) / scale + (float)xx;
-                pt.y = (points_data[j * 3 + 1]- (hpad / 2)) / scale + (float)yy;
+    hand_labels.resize(objects.size());
+    hand_probs.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        for (int j = 0; j < 21; j++)
+            objects[i].pts[j] = hands[i].pts[j];
 
-                objects[i].pts.push_back(pt);
-            }
-        }
+        objects[i].track_confidence = HandTracker::keypoint_confidence(hands[i], hand_boxes[i]);
 
+        hand_labels[i] = objects[i].label;
+        hand_probs[i] = objects[i].prob;
     }
 
+    // follow these hands on the next frames
+    tracker.update(hand_boxes, hands, hand_labels, hand_probs, true, rgb.cols, rgb.rows);
+
+    return 0;
+}
+
+int NanoDet::track(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    if (tracker.need_detect())
+        return detect(rgb, objects, prob_threshold, nms_threshold);
+
+    return track_landmarks(rgb, objects);
+}
+
+static void copy_result(const std::vector<Object>& objects, HandResult& result)
+{
+    result.count = std::min((int)objects.size(), (int)HandResult::max_hands);
+    for (int i = 0; i < result.count; i++)
+    {
+        result.objects[i] = objects[i];
+    }
+}
+
+int NanoDet::detect(const cv::Mat& rgb, HandResult& result, float prob_threshold, float nms_threshold)
+{
+    int ret = detect(rgb, result_objects, prob_threshold, nms_threshold);
+    copy_result(result_objects, result);
+    return ret;
+}
+
+int NanoDet::track(const cv::Mat& rgb, HandResult& result, float prob_threshold, float nms_threshold)
+{
+    int ret = track(rgb, result_objects, prob_threshold, nms_threshold);
+    copy_result(result_objects, result);
+    return ret;
+}
+
+bool NanoDet::need_detect() const
+{
+    return tracker.need_detect();
+}
+
+int NanoDet::track_landmarks(const cv::Mat& rgb, std::vector<Object>& objects)
+{
+    const std::vector<HandTrack>& tracks = tracker.tracks();
+
+    hand_boxes.resize(tracks.size());
+    hand_labels.resize(tracks.size());
+    hand_probs.resize(tracks.size());
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        hand_boxes[i] = tracks[i].roi;
+        hand_labels[i] = tracks[i].label;
+        hand_probs[i] = tracks[i].prob;
+    }
+
+    landmark.detect(rgb, hand_boxes, hands);
+
+    // tracked hands keep their detector score, lost hands are left out
+    objects.clear();
+    for (size_t i = 0; i < hands.size(); i++)
+    {
+        const float confidence = HandTracker::keypoint_confidence(hands[i], hand_boxes[i]);
+        if (confidence < tracker.confidence_threshold())
+            continue;
+
+        Object obj;
+        obj.rect = hand_boxes[i];
+        for (int j = 0; j < 21; j++)
+            obj.pts[j] = hands[i].pts[j];
+        obj.label = hand_labels[i];
+        obj.prob = hand_probs[i];
+        obj.track_confidence = confidence;
+        objects.push_back(obj);
+    }
+
+    tracker.update(hand_boxes, hands, hand_labels, hand_probs, false, rgb.cols, rgb.rows);
+
     // sort objects by area
     struct
     {
@@ -497,8 +554,29 @@ int NanoDet::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob
     return 0;
 }
 
-int NanoDet::draw(cv::Mat& rgb, const std::vector<Object>& objects)
+void NanoDet::set_tracking(float min_confidence, int redetect_interval)
+{
+    tracker.set_params(min_confidence, redetect_interval);
+}
+
+void NanoDet::set_num_threads(int _num_threads)
+{
+    num_threads = _num_threads;
+    landmark.set_num_threads(num_threads);
+}
+
+void NanoDet::get_arena_usage(size_t& current_bytes, size_t& peak_bytes) const
+{
+    landmark.get_arena_usage(current_bytes, peak_bytes);
+
+    current_bytes += blob_allocator.current_bytes() + workspace_allocator.current_bytes();
+    peak_bytes += blob_allocator.peak_bytes() + workspace_allocator.peak_bytes();
+}
+
+int NanoDet::draw(cv::Mat& rgb, const std::vector<Object>& objects, Overlay& overlay)
 {
+    PROFILE_STAGE(STAGE_DRAW);
+
     static const char* class_names[] = {
         "person", "hand", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
         "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
@@ -533,80 +611,39 @@ int NanoDet::draw(cv::Mat& rgb, const std::vector<Object>& objects)
         {139, 125,  96}
     };
 
-    int color_index = 0;
+    static const unsigned char black[3] = {0, 0, 0};
+    static const unsigned char white[3] = {255, 255, 255};
+
+    overlay.begin(rgb);
 
     for (size_t i = 0; i < objects.size(); i++)
     {
         const Object& obj = objects[i];
 
-//         fprintf(stderr, "%d = %.5f at %.2f %.2f %.2f x %.2f\n", obj.label, obj.prob,
-//                 obj.rect.x, obj.rect.y, obj.rect.width, obj.rect.height);
+        const unsigned char* color = colors[i % 19];
 
-        const unsigned char* color = colors[color_index % 19];
-        color_index++;
-
-        cv::Scalar cc(color[0], color[1], color[2]);
-
-        cv::rectangle(rgb, obj.rect, cc, 2);
+        overlay.rectangle(obj.rect, color, 2);
 
         char text[256];
         sprintf(text, "%s %.1f%%", class_names[obj.label], obj.prob * 100);
 
-        int baseLine = 0;
-        cv::Size label_size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
+        cv::Size label_size = overlay.text_size(text);
 
         int x = obj.rect.x;
-        int y = obj.rect.y - label_size.height - baseLine;
+        int y = obj.rect.y - label_size.height;
         if (y < 0)
             y = 0;
         if (x + label_size.width > rgb.cols)
             x = rgb.cols - label_size.width;
 
-        cv::rectangle(rgb, cv::Rect(cv::Point(x, y), cv::Size(label_size.width, label_size.height + baseLine)), cc, -1);
-
-        cv::Scalar textcc = (color[0] + color[1] + color[2] >= 381) ? cv::Scalar(0, 0, 0) : cv::Scalar(255, 255, 255);
-
-        cv::putText(rgb, text, cv::Point(x, y + label_size.height), cv::FONT_HERSHEY_SIMPLEX, 0.5, textcc, 1);
-
-
-        {
-            cv::Scalar color1(10, 215, 255);
-            cv::Scalar color2(255, 115, 55);
-            cv::Scalar color3(5, 255, 55);
-            cv::Scalar color4(25, 15, 255);
-            cv::Scalar color5(225, 15, 55);
-            for(size_t j = 0; j < obj.pts.size(); j++)
-            {
-                cv::circle(rgb, obj.pts[j],4,cv::Scalar(255,0,0),-1);
-                if (j < 4)
-                {
-                    cv::line(rgb, obj.pts[j], obj.pts[j+1], color1, 2, 8);
-                }
-                if (j < 8 && j > 4)
-                {
-                    cv::line(rgb, obj.pts[j], obj.pts[j+1], color2, 2, 8);
-                }
-                if (j < 12 && j > 8)
-                {
-                    cv::line(rgb, obj.pts[j], obj.pts[j+1], color3, 2, 8);
-                }
-                if (j < 16 && j > 12)
-                {
-                    cv::line(rgb, obj.pts[j], obj.pts[j+1], color4, 2, 8);
-                }
-                if (j < 20 && j > 16)
-                {
-                    cv::line(rgb, obj.pts[j], obj.pts[j+1], color5, 2, 8);
-                }
-            }
-            cv::line(rgb, obj.pts[0], obj.pts[5], color2, 2, 8);
-            cv::line(rgb, obj.pts[0], obj.pts[9], color3, 2, 8);
-            cv::line(rgb, obj.pts[0], obj.pts[13], color4, 2, 8);
-            cv::line(rgb, obj.pts[0], obj.pts[17], color5, 2, 8);
-        }
+        overlay.fill(cv::Rect(x, y, label_size.width, label_size.height), color);
 
+        overlay.text(x, y, text, color[0] + color[1] + color[2] >= 381 ? black : white);
 
+        overlay.hand(obj.pts);
     }
 
+    overlay.end();
+
     return 0;
 }
@@ -15,41 +15,154 @@
 #ifndef NANODET_H
 #define NANODET_H
 
+#include <memory>
+
 #include <opencv2/core/core.hpp>
 
 #include <net.h>
 
+#include "arena.h"
+#include "dfl.h"
+#include "landmark.h"
+#include "letterbox.h"
+#include "modelfile.h"
+#include "nms.h"
+#include "overlay.h"
+#include "tracker.h"
+
 struct Object
 {
     cv::Rect_<float> rect;
-    std::vector<cv::Point2f> pts;
+    cv::Point2f pts[21];
     int label;
+    // detector score, carried over while the hand is tracked
     float prob;
+    // keypoint confidence from 0 to 1, see HandTracker::keypoint_confidence, 0 for boxes without landmarks
+    float track_confidence;
+};
+
+// detect() and track() results in storage owned by the caller, nothing in it is ever allocated
+// keep one per stream and pass it every frame
+struct HandResult
+{
+    HandResult() : count(0) {}
+
+    enum { max_hands = 8 };
+
+    // the first count entries are the hands of this frame
+    Object objects[max_hands];
+    int count;
+};
+
+// param and weights of the detector and the landmark net, read only once loaded
+// any number of NanoDet sessions on any threads can share one
+class NanoDetModel
+{
+public:
+    int load(const char* modeltype, int target_size, const float* mean_vals, const float* norm_vals, bool use_gpu = false);
+
+#if __ANDROID_API__ >= 9
+    int load(AAssetManager* mgr, const char* modeltype, int target_size, const float* mean_vals, const float* norm_vals, bool use_gpu = false);
+#endif // __ANDROID_API__ >= 9
+
+private:
+    // weights of the net point into this mapping, declared first so it outlives the net
+    MappedFile model_file;
+
+public:
+    ncnn::Net nanodet;
+    std::shared_ptr<LandmarkModel> landmark;
+    int target_size;
+    float mean_vals[3];
+    float norm_vals[3];
 };
 
+// one stream: extractors, arena allocators, input and proposal scratch and the tracker,
+// used from one thread at a time, sessions sharing a model run in parallel
 class NanoDet
 {
 public:
     NanoDet();
 
+    // loads a model of its own
     int load(const char* modeltype, int target_size, const float* mean_vals, const float* norm_vals, bool use_gpu = false);
 
+#if __ANDROID_API__ >= 9
     int load(AAssetManager* mgr, const char* modeltype, int target_size, const float* mean_vals, const float* norm_vals, bool use_gpu = false);
+#endif // __ANDROID_API__ >= 9
+
+    // run on a model shared with other sessions
+    void set_model(const std::shared_ptr<const NanoDetModel>& model);
 
+    // objects is resized in place and keeps its capacity, reuse it across frames
     int detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold = 0.4f, float nms_threshold = 0.5f);
 
-    int draw(cv::Mat& rgb, const std::vector<Object>& objects);
+    // boxes only, sampled straight from the camera nv21 frame
+    // roi and rotate_type as in NdkCameraWindow, boxes are in rotated roi coordinates
+    int detect(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, std::vector<Object>& objects, float prob_threshold = 0.4f, float nms_threshold = 0.5f);
+
+    // hand landmarks for the boxes in objects
+    int detect_landmarks(const cv::Mat& rgb, std::vector<Object>& objects);
+
+    // detect() when the tracker lost a hand or is due for a redetect, track_landmarks() otherwise
+    int track(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold = 0.4f, float nms_threshold = 0.5f);
+
+    // detect() and track() into a HandResult, hands past HandResult::max_hands are left out
+    // no heap allocation in the session once the first frames grew its scratch, only inside ncnn::Extractor
+    int detect(const cv::Mat& rgb, HandResult& result, float prob_threshold = 0.4f, float nms_threshold = 0.5f);
+    int track(const cv::Mat& rgb, HandResult& result, float prob_threshold = 0.4f, float nms_threshold = 0.5f);
+
+    // true when the next frame needs the box detector
+    bool need_detect() const;
+
+    // landmarks only, on the rois predicted from the previous frame keypoints
+    // prob keeps the detector score of the hand, lost hands are left out
+    int track_landmarks(const cv::Mat& rgb, std::vector<Object>& objects);
+
+    // see HandTracker::set_params, redetect_interval 0 runs the detector on every frame
+    void set_tracking(float min_confidence, int redetect_interval);
+
+    // detector and landmark threads, overrides the big core count picked at load
+    void set_num_threads(int num_threads);
+
+    // optional, run after load(): one blank target_size x target_size frame through the detector
+    // and blank hands through the landmark net, returns the time spent in ms
+    double warmup();
+
+    // bytes held by the detector and landmark arenas right now and at most
+    void get_arena_usage(size_t& current_bytes, size_t& peak_bytes) const;
+
+    static int draw(cv::Mat& rgb, const std::vector<Object>& objects, Overlay& overlay);
 
 private:
-    ncnn::Net nanodet;
-    ncnn::Net handpt;
+    // in_pad holds the img_w x img_h image scaled by scale and placed at (left, top)
+    int detect_boxes(int img_w, int img_h, float scale, int left, int top, std::vector<Object>& objects, float prob_threshold, float nms_threshold);
+
+private:
+    std::shared_ptr<const NanoDetModel> model;
+    LandmarkDetect landmark;
+    int num_threads;
+    DFLDecoder dfl;
+    BoxNms nms;
+    Letterbox letterbox;
+    // reused across frames
+    ncnn::Mat in_pad;
+    std::vector<Object> proposals;
+    std::vector<int> picked;
+    std::vector<cv::Rect> hand_boxes;
+    std::vector<HandLandmarks> hands;
+    std::vector<int> hand_labels;
+    std::vector<float> hand_probs;
+    // objects of the HandResult overloads
+    std::vector<Object> result_objects;
+    HandTracker tracker;
+    // copied from the model
     int target_size;
     float mean_vals[3];
     float norm_vals[3];
-    const float meanVals[3] = { 128.0f, 128.0f,  128.0f };
-    const float normVals[3] = { 0.00390625f, 0.00390625f, 0.00390625f };
-    ncnn::UnlockedPoolAllocator blob_pool_allocator;
-    ncnn::PoolAllocator workspace_pool_allocator;
+    // detector net only, the landmark session has its own per hand slot
+    ArenaAllocator blob_allocator;
+    LockedArenaAllocator workspace_allocator;
 };
 
 #endif // NANODET_H
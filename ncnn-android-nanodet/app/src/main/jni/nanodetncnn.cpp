@@ -20,6 +20,8 @@
 
 #include <jni.h>
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -28,15 +30,17 @@
 
 #include "nanodet.h"
 
+#include "blit.h"
+#include "hotswap.h"
 #include "ndkcamera.h"
+#include "nv21.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "tracer.h"
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
-#if __ARM_NEON
-#include <arm_neon.h>
-#endif // __ARM_NEON
-
 static int draw_unsupported(cv::Mat& rgb)
 {
     const char text[] = "unsupported";
@@ -48,10 +52,10 @@ static int draw_unsupported(cv::Mat& rgb)
     int x = (rgb.cols - label_size.width) / 2;
 
     cv::rectangle(rgb, cv::Rect(cv::Point(x, y), cv::Size(label_size.width, label_size.height + baseLine)),
-                    cv::Scalar(255, 255, 255), -1);
+                    cv::Scalar(255, 255, 255, 255), -1);
 
     cv::putText(rgb, text, cv::Point(x, y + label_size.height),
-                cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 0));
+                cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 0, 255));
 
     return 0;
 }
@@ -102,16 +106,31 @@ static int draw_fps(cv::Mat& rgb)
     int x = rgb.cols - label_size.width;
 
     cv::rectangle(rgb, cv::Rect(cv::Point(x, y), cv::Size(label_size.width, label_size.height + baseLine)),
-                    cv::Scalar(255, 255, 255), -1);
+                    cv::Scalar(255, 255, 255, 255), -1);
 
     cv::putText(rgb, text, cv::Point(x, y + label_size.height),
-                cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0));
+                cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0, 255));
 
     return 0;
 }
 
-static NanoDet* g_nanodet = 0;
-static ncnn::Mutex lock;
+// the detector in use, reloads are built off the frame loop and swapped in when ready
+static HotSwap<NanoDet> g_nanodet;
+
+// one camera frame on its way through the pipeline
+struct CameraFrame
+{
+    cv::Mat rgb;
+    // the camera roi as a compact nv21 image, the detector samples it directly and infer() converts it to rgb
+    std::vector<unsigned char> nv21;
+    int nv21_width;
+    int nv21_height;
+    int rotate_type;
+    std::vector<Object> objects;
+    bool has_model;
+    // camera frame number, tags the trace events of later stages
+    int frame_number;
+};
 
 class MyNdkCamera : public NdkCamera
 {
@@ -119,10 +138,22 @@ public:
     MyNdkCamera();
     ~MyNdkCamera();
     void set_window(ANativeWindow* win);
-    virtual void on_image(const cv::Mat& rgb) const;
+
+    // inference and render threads, started around open and close
+    void start();
+    void stop();
+
+    virtual void on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const;
+
+private:
+    void infer(CameraFrame& frame) const;
+    void render(CameraFrame& frame) const;
 
 private:
     ANativeWindow* win;
+    mutable FramePipeline<CameraFrame> pipeline;
+    // only used from the render thread
+    mutable Overlay overlay;
 };
 
 MyNdkCamera::MyNdkCamera()
@@ -132,6 +163,8 @@ MyNdkCamera::MyNdkCamera()
 
 MyNdkCamera::~MyNdkCamera()
 {
+    stop();
+
     if (win)
     {
         ANativeWindow_release(win);
@@ -149,103 +182,144 @@ void MyNdkCamera::set_window(ANativeWindow* _win)
     ANativeWindow_acquire(win);
 }
 
-void MyNdkCamera::on_image(const cv::Mat& rgb) const
+void MyNdkCamera::start()
+{
+    pipeline.start(std::bind(&MyNdkCamera::infer, this, std::placeholders::_1), std::bind(&MyNdkCamera::render, this, std::placeholders::_1));
+}
+
+void MyNdkCamera::stop()
+{
+    pipeline.stop();
+}
+
+void MyNdkCamera::on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const
 {
-    // render to window
     int target_width = ANativeWindow_getWidth(win);
     int target_height = ANativeWindow_getHeight(win);
 //     int target_format = ANativeWindow_getFormat(win);
 
-    // crop to target aspect ratio
-    cv::Mat rgb_roi;
+    int w;
+    int h;
+    int rotate_type;
+    upright_rotation(nv21_width, nv21_height, w, h, rotate_type);
+
+    // crop to target aspect ratio, even so that the roi maps onto whole nv21 chroma samples
+    int roi_x;
+    int roi_y;
+    int roi_w;
+    int roi_h;
+    if (target_width * h > target_height * w)
     {
-        int w = rgb.cols;
-        int h = rgb.rows;
+        roi_w = w;
+        roi_h = (w * target_height / target_width) / 2 * 2;
+        roi_x = 0;
+        roi_y = ((h - roi_h) / 2) / 2 * 2;
+    }
+    else
+    {
+        roi_h = h;
+        roi_w = (h * target_width / target_height) / 2 * 2;
+        roi_x = ((w - roi_w) / 2) / 2 * 2;
+        roi_y = 0;
+    }
 
-        cv::Rect roi;
+    nv21_unrotate_roi(nv21_width, nv21_height, rotate_type, roi_x, roi_y, roi_w, roi_h);
 
-        if (target_width * h > target_height * w)
-        {
-            roi.width = w;
-            roi.height = w * target_height / target_width;
-            roi.x = 0;
-            roi.y = (h - roi.height) / 2;
-        }
-        else
-        {
-            roi.height = h;
-            roi.width = h * target_width / target_height;
-            roi.x = (w - roi.width) / 2;
-            roi.y = 0;
-        }
+    // dropped when every frame is still in flight, the camera thread only copies the roi of accepted frames
+    pipeline.capture([&](CameraFrame& frame)
+    {
+        // the camera reuses its nv21 buffer, copy the roi into the pooled frame
+        frame.nv21.resize(roi_w * roi_h * 3 / 2);
+        nv21_roi_copy(nv21, nv21_width, nv21_height, roi_x, roi_y, roi_w, roi_h, frame.nv21.data());
+        frame.nv21_width = roi_w;
+        frame.nv21_height = roi_h;
+        frame.rotate_type = rotate_type;
+
+        frame.frame_number = Tracer::frame();
+    });
+}
 
-        rgb_roi = rgb(roi).clone();
-    }
+void MyNdkCamera::infer(CameraFrame& frame) const
+{
+    TRACE_FRAME(frame.frame_number);
+    TRACE_SCOPE("infer");
 
-    // nanodet
+    // every frame in the pipeline is rendered, crop, rotate and convert it once here into its reused rgb buffer
+    const int w = frame.rotate_type <= 4 ? frame.nv21_width : frame.nv21_height;
+    const int h = frame.rotate_type <= 4 ? frame.nv21_height : frame.nv21_width;
+    frame.rgb.create(h, w, CV_8UC3);
     {
-        ncnn::MutexLockGuard g(lock);
+        PROFILE_STAGE(STAGE_CAMERA);
+        nv21_roi_rotate_to_rgb(frame.nv21.data(), frame.nv21_width, frame.nv21_height, 0, 0, frame.nv21_width, frame.nv21_height, frame.rotate_type, frame.rgb.data, (int)frame.rgb.step[0]);
+    }
 
-        if (g_nanodet)
-        {
-            std::vector<Object> objects;
-            g_nanodet->detect(rgb_roi, objects);
+    // hold on to this frame's instance, a reload may publish a new one meanwhile
+    std::shared_ptr<NanoDet> detector = g_nanodet.get();
 
-            g_nanodet->draw(rgb_roi, objects);
+    frame.has_model = detector != 0;
+    if (detector)
+    {
+        if (detector->need_detect())
+        {
+            // boxes straight from the nv21 roi, only the landmark crops read the rgb frame
+            int ret = detector->detect(frame.nv21.data(), frame.nv21_width, frame.nv21_height, 0, 0, frame.nv21_width, frame.nv21_height, frame.rotate_type, frame.objects);
+            if (ret == 0)
+            {
+                detector->detect_landmarks(frame.rgb, frame.objects);
+            }
         }
         else
         {
-            draw_unsupported(rgb_roi);
+            detector->track_landmarks(frame.rgb, frame.objects);
         }
     }
+    else
+    {
+        frame.objects.clear();
+    }
+}
 
-    draw_fps(rgb_roi);
+void MyNdkCamera::render(CameraFrame& frame) const
+{
+    TRACE_FRAME(frame.frame_number);
+    TRACE_SCOPE("render");
 
-    ANativeWindow_setBuffersGeometry(win, rgb_roi.cols, rgb_roi.rows, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM);
+    const cv::Mat& rgb = frame.rgb;
+
+    // render to window
+    ANativeWindow_setBuffersGeometry(win, rgb.cols, rgb.rows, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM);
 
     ANativeWindow_Buffer buf;
     ANativeWindow_lock(win, &buf, NULL);
 
-     //__android_log_print(ANDROID_LOG_WARN, "ncnn", "on_image %d %d -> %d %d -> %d %d -> %d %d %d", rgb.cols, rgb.rows, target_width, target_height, rgb_roi.cols, rgb_roi.rows, buf.width, buf.height, buf.stride);
+     //__android_log_print(ANDROID_LOG_WARN, "ncnn", "render %d %d -> %d %d %d", rgb.cols, rgb.rows, buf.width, buf.height, buf.stride);
 
-    // scale to target size
     if (buf.format == AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM || buf.format == AHARDWAREBUFFER_FORMAT_R8G8B8X8_UNORM)
     {
-        for (int y = 0; y < rgb_roi.rows; y++)
+        // expand to rgba straight into the window buffer and draw the overlays there
         {
-            const unsigned char* ptr = rgb_roi.ptr<const unsigned char>(y);
-            unsigned char* outptr = (unsigned char*)buf.bits + buf.stride * 4 * y;
+            PROFILE_STAGE(STAGE_BLIT);
+            rgb_rotate_to_rgba(rgb.data, rgb.cols, rgb.rows, (int)rgb.step[0], (unsigned char*)buf.bits, rgb.cols, rgb.rows, buf.stride * 4, 1);
+        }
 
-            int x = 0;
-#if __ARM_NEON
-            for (; x + 7 < rgb_roi.cols; x += 8)
-            {
-                uint8x8x3_t _rgb = vld3_u8(ptr);
-                uint8x8x4_t _rgba;
-                _rgba.val[0] = _rgb.val[0];
-                _rgba.val[1] = _rgb.val[1];
-                _rgba.val[2] = _rgb.val[2];
-                _rgba.val[3] = vdup_n_u8(255);
-                vst4_u8(outptr, _rgba);
-
-                ptr += 24;
-                outptr += 32;
-            }
-#endif // __ARM_NEON
-            for (; x < rgb_roi.cols; x++)
-            {
-                outptr[0] = ptr[0];
-                outptr[1] = ptr[1];
-                outptr[2] = ptr[2];
-                outptr[3] = 255;
+        cv::Mat rgba(rgb.rows, rgb.cols, CV_8UC4, buf.bits, buf.stride * 4);
 
-                ptr += 3;
-                outptr += 4;
-            }
+        if (frame.has_model)
+        {
+            NanoDet::draw(rgba, frame.objects, overlay);
+        }
+        else
+        {
+            draw_unsupported(rgba);
         }
+
+        draw_fps(rgba);
     }
 
-    ANativeWindow_unlockAndPost(win);
+    {
+        TRACE_SCOPE("unlock_and_post");
+        ANativeWindow_unlockAndPost(win);
+    }
 }
 
 static MyNdkCamera* g_camera = 0;
@@ -265,15 +339,13 @@ JNIEXPORT void JNI_OnUnload(JavaVM* vm, void* reserved)
 {
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "JNI_OnUnload");
 
-    {
-        ncnn::MutexLockGuard g(lock);
-
-        delete g_nanodet;
-        g_nanodet = 0;
-    }
-
     delete g_camera;
     g_camera = 0;
+
+    // the last instance is destroyed on the loader thread, wait for it before the library goes away
+    g_nanodet.wait_idle();
+    g_nanodet.publish(std::shared_ptr<NanoDet>());
+    g_nanodet.wait_idle();
 }
 
 // public native boolean loadModel(AssetManager mgr, int modelid, int cpugpu);
@@ -308,22 +380,35 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_nanodetncnn_NanoDetNcnn_loadModel(JN
     int target_size = target_sizes[(int)modelid];
     bool use_gpu = (int)cpugpu == 1;
 
-    // reload
+    // reload in the background, frames keep using the current instance until the new one is ready
+    if (use_gpu && ncnn::get_gpu_count() == 0)
+    {
+        // no gpu
+        g_nanodet.load_async([](std::shared_ptr<NanoDet>&) { return 0; });
+    }
+    else
     {
-        ncnn::MutexLockGuard g(lock);
+        std::vector<float> mean(mean_vals[(int)modelid], mean_vals[(int)modelid] + 3);
+        std::vector<float> norm(norm_vals[(int)modelid], norm_vals[(int)modelid] + 3);
+
+        // the asset manager belongs to the application and outlives the load
+        g_nanodet.load_async([=](std::shared_ptr<NanoDet>& instance) {
+            std::shared_ptr<NanoDet> detector = std::make_shared<NanoDet>();
+            int ret = detector->load(mgr, modeltype, target_size, mean.data(), norm.data(), use_gpu);
+            if (ret != 0)
+            {
+                // frames keep running on the instance already published
+                __android_log_print(ANDROID_LOG_WARN, "ncnn", "load %s failed %d", modeltype, ret);
+                return ret;
+            }
 
-        if (use_gpu && ncnn::get_gpu_count() == 0)
-        {
-            // no gpu
-            delete g_nanodet;
-            g_nanodet = 0;
-        }
-        else
-        {
-            if (!g_nanodet)
-                g_nanodet = new NanoDet;
-            g_nanodet->load(mgr, modeltype, target_size, mean_vals[(int)modelid], norm_vals[(int)modelid], use_gpu);
-        }
+            // the first camera frame should not pay for pipeline creation and pool growth
+            double warmup_time = detector->warmup();
+            __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "warmup %s %.2fms", modeltype, warmup_time);
+
+            instance = detector;
+            return 0;
+        });
     }
 
     return JNI_TRUE;
@@ -337,6 +422,7 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_nanodetncnn_NanoDetNcnn_openCamera(J
 
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "openCamera %d", facing);
 
+    g_camera->start();
     g_camera->open((int)facing);
 
     return JNI_TRUE;
@@ -348,6 +434,7 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_nanodetncnn_NanoDetNcnn_closeCamera(
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "closeCamera");
 
     g_camera->close();
+    g_camera->stop();
 
     return JNI_TRUE;
 }
@@ -364,4 +451,46 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_nanodetncnn_NanoDetNcnn_setOutputWin
     return JNI_TRUE;
 }
 
+// public native float[] getStageLatency();
+// p50, p95 and p99 in ms for each stage: camera preprocess inference decode nms landmark draw blit
+JNIEXPORT jfloatArray JNICALL Java_com_tencent_nanodetncnn_NanoDetNcnn_getStageLatency(JNIEnv* env, jobject thiz)
+{
+    float latency[STAGE_COUNT * 3];
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        StageProfiler::query(i, latency[i * 3], latency[i * 3 + 1], latency[i * 3 + 2]);
+    }
+
+    jfloatArray result = env->NewFloatArray(STAGE_COUNT * 3);
+    if (!result)
+        return 0;
+
+    env->SetFloatArrayRegion(result, 0, STAGE_COUNT * 3, latency);
+
+    return result;
+}
+
+// public native boolean startTrace();
+JNIEXPORT jboolean JNICALL Java_com_tencent_nanodetncnn_NanoDetNcnn_startTrace(JNIEnv* env, jobject thiz)
+{
+    Tracer::start();
+
+    return JNI_TRUE;
+}
+
+// public native boolean dumpTrace(String path);
+// stops tracing and writes chrome trace json to path
+JNIEXPORT jboolean JNICALL Java_com_tencent_nanodetncnn_NanoDetNcnn_dumpTrace(JNIEnv* env, jobject thiz, jstring path)
+{
+    const char* trace_path = env->GetStringUTFChars(path, 0);
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "dumpTrace %s", trace_path);
+
+    int ret = Tracer::dump(trace_path);
+
+    env->ReleaseStringUTFChars(path, trace_path);
+
+    return ret == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
 }
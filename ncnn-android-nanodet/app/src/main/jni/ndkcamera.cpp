@@ -20,7 +20,9 @@
 
 #include <opencv2/core/core.hpp>
 
-#include "mat.h"
+#include "nv21.h"
+#include "profiler.h"
+#include "tracer.h"
 
 static void onDisconnected(void* context, ACameraDevice* device)
 {
@@ -36,6 +38,11 @@ static void onImageAvailable(void* context, AImageReader* reader)
 {
 //     __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "onImageAvailable %p", reader);
 
+    // the camera callbacks come from a single thread
+    static int frame_number = 0;
+    TRACE_FRAME(frame_number++);
+    TRACE_SCOPE("camera_image");
+
     AImage* image = 0;
     media_status_t status = AImageReader_acquireLatestImage(reader, &image);
 
@@ -86,42 +93,14 @@ static void onImageAvailable(void* context, AImageReader* reader)
     }
     else
     {
-        // construct nv21
-        unsigned char* nv21 = new unsigned char[width * height + width * height / 2];
-        {
-            // Y
-            unsigned char* yptr = nv21;
-            for (int y=0; y<height; y++)
-            {
-                const unsigned char* y_data_ptr = y_data + y_rowStride * y;
-                for (int x=0; x<width; x++)
-                {
-                    yptr[0] = y_data_ptr[0];
-                    yptr++;
-                    y_data_ptr += y_pixelStride;
-                }
-            }
+        // construct nv21 in the buffer kept by the camera
+        NdkCamera* camera = (NdkCamera*)context;
+        unsigned char* nv21 = camera->get_nv21_buffer(width, height);
 
-            // UV
-            unsigned char* uvptr = nv21 + width * height;
-            for (int y=0; y<height/2; y++)
-            {
-                const unsigned char* v_data_ptr = v_data + v_rowStride * y;
-                const unsigned char* u_data_ptr = u_data + u_rowStride * y;
-                for (int x=0; x<width/2; x++)
-                {
-                    uvptr[0] = v_data_ptr[0];
-                    uvptr[1] = u_data_ptr[0];
-                    uvptr += 2;
-                    v_data_ptr += v_pixelStride;
-                    u_data_ptr += u_pixelStride;
-                }
-            }
-        }
-
-        ((NdkCamera*)context)->on_image((unsigned char*)nv21, (int)width, (int)height);
+        TRACE_SCOPE("repack_nv21");
+        yuv420_to_nv21(y_data, y_rowStride, y_pixelStride, u_data, u_rowStride, u_pixelStride, v_data, v_rowStride, v_pixelStride, width, height, nv21);
 
-        delete[] nv21;
+        camera->on_image(nv21, (int)width, (int)height);
     }
 
     AImage_delete(image);
@@ -182,6 +161,13 @@ NdkCamera::NdkCamera()
     {
         AImageReader_new(640, 480, AIMAGE_FORMAT_YUV_420_888, /*maxImages*/2, &image_reader);
 
+        // frames are repacked one at a time on the listener thread, one buffer serves them all
+        int32_t width = 0;
+        int32_t height = 0;
+        AImageReader_getWidth(image_reader, &width);
+        AImageReader_getHeight(image_reader, &height);
+        nv21_buffer.resize(width * height + width * height / 2);
+
         AImageReader_ImageListener listener;
         listener.context = this;
         listener.onImageAvailable = onImageAvailable;
@@ -372,16 +358,24 @@ void NdkCamera::close()
     }
 }
 
+unsigned char* NdkCamera::get_nv21_buffer(int width, int height)
+{
+    const size_t size = width * height + width * height / 2;
+    if (nv21_buffer.size() < size)
+        nv21_buffer.resize(size);
+
+    return nv21_buffer.data();
+}
+
 void NdkCamera::on_image(const cv::Mat& rgb) const
 {
 }
 
-void NdkCamera::on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const
+void NdkCamera::upright_rotation(int nv21_width, int nv21_height, int& w, int& h, int& rotate_type) const
 {
-    // rotate nv21
-    int w = 0;
-    int h = 0;
-    int rotate_type = 0;
+    w = 0;
+    h = 0;
+    rotate_type = 0;
     if (camera_orientation == 0)
     {
         w = nv21_width;
@@ -406,13 +400,22 @@ void NdkCamera::on_image(const unsigned char* nv21, int nv21_width, int nv21_hei
         h = nv21_width;
         rotate_type = camera_facing == 0 ? 7 : 8;
     }
+}
 
-    cv::Mat nv21_rotated(h + h / 2, w, CV_8UC1);
-    ncnn::kanna_rotate_yuv420sp(nv21, nv21_width, nv21_height, nv21_rotated.data, w, h, rotate_type);
+void NdkCamera::on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const
+{
+    // rotate nv21
+    int w;
+    int h;
+    int rotate_type;
+    upright_rotation(nv21_width, nv21_height, w, h, rotate_type);
 
-    // nv21_rotated to rgb
-    cv::Mat rgb(h, w, CV_8UC3);
-    ncnn::yuv420sp2rgb(nv21_rotated.data, w, h, rgb.data);
+    // rotate and convert to rgb in one pass
+    rgb_buffer.create(h, w, CV_8UC3);
+    {
+        PROFILE_STAGE(STAGE_CAMERA);
+        nv21_roi_rotate_to_rgb(nv21, nv21_width, nv21_height, 0, 0, nv21_width, nv21_height, rotate_type, rgb_buffer.data, (int)rgb_buffer.step[0]);
+    }
 
-    on_image(rgb);
+    on_image(rgb_buffer);
 }
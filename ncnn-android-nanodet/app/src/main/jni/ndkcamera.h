@@ -20,6 +20,8 @@
 #include <camera/NdkCameraMetadata.h>
 #include <media/NdkImageReader.h>
 
+#include <vector>
+
 #include <opencv2/core/core.hpp>
 
 class NdkCamera
@@ -36,10 +38,20 @@ public:
 
     virtual void on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const;
 
+    // repack target for frames that do not arrive as nv21, allocated once from the image reader size
+    unsigned char* get_nv21_buffer(int width, int height);
+
 public:
     int camera_facing;
     int camera_orientation;
 
+protected:
+    // upright frame size w x h and the rotate_type turning an nv21 frame upright
+    void upright_rotation(int nv21_width, int nv21_height, int& w, int& h, int& rotate_type) const;
+
+    // rgb conversion target, reused across frames
+    mutable cv::Mat rgb_buffer;
+
 private:
     ACameraManager* camera_manager;
     ACameraDevice* camera_device;
@@ -50,6 +62,8 @@ private:
     ACaptureSessionOutputContainer* capture_session_output_container;
     ACaptureSessionOutput* capture_session_output;
     ACameraCaptureSession* capture_session;
+
+    std::vector<unsigned char> nv21_buffer;
 };
 
 #endif // NDKCAMERA_H
@@ -0,0 +1,179 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "nms.h"
+
+#include <algorithm>
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#if __AVX__
+#include <immintrin.h>
+#endif // __AVX__
+#endif // __ARM_NEON
+
+void BoxNms::clear()
+{
+    order.clear();
+    x0.clear();
+    y0.clear();
+    x1.clear();
+    y1.clear();
+    areas.clear();
+}
+
+void BoxNms::push_back(float x, float y, float width, float height, float score)
+{
+    ScoreIndex si;
+    si.score = score;
+    si.index = (int)order.size();
+    order.push_back(si);
+
+    x0.push_back(x);
+    y0.push_back(y);
+    x1.push_back(x + width);
+    y1.push_back(y + height);
+    areas.push_back(width * height);
+}
+
+int BoxNms::size() const
+{
+    return (int)order.size();
+}
+
+// returns nonzero if candidate i overlaps any of the n picked boxes above nms_threshold
+static int overlaps_any(float ax0, float ay0, float ax1, float ay1, float aarea,
+                        const float* px0, const float* py0, const float* px1, const float* py1, const float* pareas,
+                        int n, float nms_threshold)
+{
+    // inter / union > nms_threshold  <=>  inter > nms_threshold * union, union is never negative
+    int j = 0;
+#if __ARM_NEON
+    {
+        float32x4_t _ax0 = vdupq_n_f32(ax0);
+        float32x4_t _ay0 = vdupq_n_f32(ay0);
+        float32x4_t _ax1 = vdupq_n_f32(ax1);
+        float32x4_t _ay1 = vdupq_n_f32(ay1);
+        float32x4_t _aarea = vdupq_n_f32(aarea);
+        float32x4_t _thresh = vdupq_n_f32(nms_threshold);
+        float32x4_t _zero = vdupq_n_f32(0.f);
+        for (; j + 3 < n; j += 4)
+        {
+            float32x4_t _w = vsubq_f32(vminq_f32(_ax1, vld1q_f32(px1 + j)), vmaxq_f32(_ax0, vld1q_f32(px0 + j)));
+            float32x4_t _h = vsubq_f32(vminq_f32(_ay1, vld1q_f32(py1 + j)), vmaxq_f32(_ay0, vld1q_f32(py0 + j)));
+            float32x4_t _inter = vmulq_f32(vmaxq_f32(_w, _zero), vmaxq_f32(_h, _zero));
+            float32x4_t _union = vsubq_f32(vaddq_f32(_aarea, vld1q_f32(pareas + j)), _inter);
+            uint32x4_t _mask = vcgtq_f32(_inter, vmulq_f32(_union, _thresh));
+            uint32x2_t _mask2 = vorr_u32(vget_low_u32(_mask), vget_high_u32(_mask));
+            if (vget_lane_u32(vpmax_u32(_mask2, _mask2), 0))
+                return 1;
+        }
+    }
+#elif __SSE2__
+#if __AVX__
+    {
+        __m256 _ax0 = _mm256_set1_ps(ax0);
+        __m256 _ay0 = _mm256_set1_ps(ay0);
+        __m256 _ax1 = _mm256_set1_ps(ax1);
+        __m256 _ay1 = _mm256_set1_ps(ay1);
+        __m256 _aarea = _mm256_set1_ps(aarea);
+        __m256 _thresh = _mm256_set1_ps(nms_threshold);
+        __m256 _zero = _mm256_setzero_ps();
+        for (; j + 7 < n; j += 8)
+        {
+            __m256 _w = _mm256_sub_ps(_mm256_min_ps(_ax1, _mm256_loadu_ps(px1 + j)), _mm256_max_ps(_ax0, _mm256_loadu_ps(px0 + j)));
+            __m256 _h = _mm256_sub_ps(_mm256_min_ps(_ay1, _mm256_loadu_ps(py1 + j)), _mm256_max_ps(_ay0, _mm256_loadu_ps(py0 + j)));
+            __m256 _inter = _mm256_mul_ps(_mm256_max_ps(_w, _zero), _mm256_max_ps(_h, _zero));
+            __m256 _union = _mm256_sub_ps(_mm256_add_ps(_aarea, _mm256_loadu_ps(pareas + j)), _inter);
+            __m256 _mask = _mm256_cmp_ps(_inter, _mm256_mul_ps(_union, _thresh), _CMP_GT_OQ);
+            if (_mm256_movemask_ps(_mask))
+                return 1;
+        }
+    }
+#endif // __AVX__
+    {
+        __m128 _ax0 = _mm_set1_ps(ax0);
+        __m128 _ay0 = _mm_set1_ps(ay0);
+        __m128 _ax1 = _mm_set1_ps(ax1);
+        __m128 _ay1 = _mm_set1_ps(ay1);
+        __m128 _aarea = _mm_set1_ps(aarea);
+        __m128 _thresh = _mm_set1_ps(nms_threshold);
+        __m128 _zero = _mm_setzero_ps();
+        for (; j + 3 < n; j += 4)
+        {
+            __m128 _w = _mm_sub_ps(_mm_min_ps(_ax1, _mm_loadu_ps(px1 + j)), _mm_max_ps(_ax0, _mm_loadu_ps(px0 + j)));
+            __m128 _h = _mm_sub_ps(_mm_min_ps(_ay1, _mm_loadu_ps(py1 + j)), _mm_max_ps(_ay0, _mm_loadu_ps(py0 + j)));
+            __m128 _inter = _mm_mul_ps(_mm_max_ps(_w, _zero), _mm_max_ps(_h, _zero));
+            __m128 _union = _mm_sub_ps(_mm_add_ps(_aarea, _mm_loadu_ps(pareas + j)), _inter);
+            __m128 _mask = _mm_cmpgt_ps(_inter, _mm_mul_ps(_union, _thresh));
+            if (_mm_movemask_ps(_mask))
+                return 1;
+        }
+    }
+#endif // __ARM_NEON
+    for (; j < n; j++)
+    {
+        float w = std::min(ax1, px1[j]) - std::max(ax0, px0[j]);
+        float h = std::min(ay1, py1[j]) - std::max(ay0, py0[j]);
+        float inter = std::max(w, 0.f) * std::max(h, 0.f);
+        float uni = aarea + pareas[j] - inter;
+        if (inter > nms_threshold * uni)
+            return 1;
+    }
+
+    return 0;
+}
+
+// equal scores fall back to push order, partial_sort is not stable
+static bool score_index_greater(const ScoreIndex& a, const ScoreIndex& b)
+{
+    return a.score > b.score || (a.score == b.score && a.index < b.index);
+}
+
+void BoxNms::run(std::vector<int>& picked, float nms_threshold, int topk)
+{
+    picked.clear();
+
+    int n = size();
+    if (topk > 0 && topk < n)
+        n = topk;
+
+    // partial selection of the n best, boxes themselves never move
+    std::partial_sort(order.begin(), order.begin() + n, order.end(), score_index_greater);
+
+    picked_x0.clear();
+    picked_y0.clear();
+    picked_x1.clear();
+    picked_y1.clear();
+    picked_areas.clear();
+
+    for (int k = 0; k < n; k++)
+    {
+        const int i = order[k].index;
+        const int num_picked = (int)picked_areas.size();
+        if (num_picked > 0 && overlaps_any(x0[i], y0[i], x1[i], y1[i], areas[i],
+                                           &picked_x0[0], &picked_y0[0], &picked_x1[0], &picked_y1[0], &picked_areas[0],
+                                           num_picked, nms_threshold))
+            continue;
+
+        picked.push_back(i);
+        picked_x0.push_back(x0[i]);
+        picked_y0.push_back(y0[i]);
+        picked_x1.push_back(x1[i]);
+        picked_y1.push_back(y1[i]);
+        picked_areas.push_back(areas[i]);
+    }
+}
@@ -0,0 +1,58 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef NMS_H
+#define NMS_H
+
+#include <vector>
+
+struct ScoreIndex
+{
+    float score;
+    int index;
+};
+
+// greedy nms over boxes kept as structure of arrays
+// candidates may be pushed in any order, only (score, index) pairs get sorted
+class BoxNms
+{
+public:
+    void clear();
+
+    void push_back(float x, float y, float width, float height, float score);
+
+    int size() const;
+
+    // picked receives candidate push indexes from highest to lowest score, equal scores in push order
+    // only the topk highest scoring candidates are considered when topk > 0
+    void run(std::vector<int>& picked, float nms_threshold, int topk = -1);
+
+private:
+    std::vector<ScoreIndex> order;
+
+    std::vector<float> x0;
+    std::vector<float> y0;
+    std::vector<float> x1;
+    std::vector<float> y1;
+    std::vector<float> areas;
+
+    // picked boxes, compared against each new candidate
+    std::vector<float> picked_x0;
+    std::vector<float> picked_y0;
+    std::vector<float> picked_x1;
+    std::vector<float> picked_y1;
+    std::vector<float> picked_areas;
+};
+
+#endif // NMS_H
@@ -0,0 +1,310 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "overlay.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+// label font, as the detectors always drew it
+static const int font_face = cv::FONT_HERSHEY_SIMPLEX;
+static const double font_scale = 0.5;
+static const int font_thickness = 1;
+
+// glyph masks leave room for strokes reaching past the advance box
+static const int glyph_pad = 2;
+
+// from, to, color index into hand_colors
+static const int hand_bones[20][3] = {
+    {0, 1, 0}, {1, 2, 0}, {2, 3, 0}, {3, 4, 0},
+    {0, 5, 1}, {5, 6, 1}, {6, 7, 1}, {7, 8, 1},
+    {0, 9, 2}, {9, 10, 2}, {10, 11, 2}, {11, 12, 2},
+    {0, 13, 3}, {13, 14, 3}, {14, 15, 3}, {15, 16, 3},
+    {0, 17, 4}, {17, 18, 4}, {18, 19, 4}, {19, 20, 4}
+};
+
+static const unsigned char hand_colors[5][3] = {
+    { 10, 215, 255},
+    {255, 115,  55},
+    {  5, 255,  55},
+    { 25,  15, 255},
+    {225,  15,  55}
+};
+
+static const unsigned char joint_color[3] = {255, 0, 0};
+
+Overlay::Overlay()
+{
+    antialias = false;
+
+    glyphs.resize(128);
+    for (size_t i = 0; i < glyphs.size(); i++)
+    {
+        glyphs[i].advance = -1.0;
+    }
+
+    cv::Size size = cv::getTextSize("0", font_face, font_scale, font_thickness, &text_baseline);
+    text_height = size.height;
+}
+
+void Overlay::set_antialias(bool _antialias)
+{
+    antialias = _antialias;
+}
+
+void Overlay::begin(cv::Mat& _image)
+{
+    image = _image;
+}
+
+void Overlay::end()
+{
+    image.release();
+}
+
+bool Overlay::clip(cv::Rect& rect)
+{
+    rect &= cv::Rect(0, 0, image.cols, image.rows);
+    return rect.width > 0 && rect.height > 0;
+}
+
+void Overlay::fill_clipped(const cv::Rect& rect, const unsigned char* color)
+{
+    const int cn = image.channels();
+    const unsigned char alpha = 255;
+
+    for (int y = rect.y; y < rect.y + rect.height; y++)
+    {
+        unsigned char* p = image.ptr<unsigned char>(y) + rect.x * cn;
+        if (cn == 4)
+        {
+            for (int x = 0; x < rect.width; x++)
+            {
+                p[0] = color[0];
+                p[1] = color[1];
+                p[2] = color[2];
+                p[3] = alpha;
+                p += 4;
+            }
+        }
+        else
+        {
+            for (int x = 0; x < rect.width; x++)
+            {
+                p[0] = color[0];
+                p[1] = color[1];
+                p[2] = color[2];
+                p += 3;
+            }
+        }
+    }
+}
+
+void Overlay::fill(const cv::Rect& _rect, const unsigned char* color)
+{
+    cv::Rect rect = _rect;
+    if (!clip(rect))
+        return;
+
+    fill_clipped(rect, color);
+}
+
+void Overlay::rectangle(const cv::Rect& rect, const unsigned char* color, int thickness)
+{
+    // four bands centered on the outline, as cv::rectangle does
+    const int t0 = thickness / 2;
+    const int x0 = rect.x - t0;
+    const int y0 = rect.y - t0;
+    const int x1 = rect.x + rect.width - t0;
+    const int y1 = rect.y + rect.height - t0;
+
+    fill(cv::Rect(x0, y0, x1 - x0 + thickness, thickness), color);
+    fill(cv::Rect(x0, y1, x1 - x0 + thickness, thickness), color);
+    fill(cv::Rect(x0, y0 + thickness, thickness, y1 - y0 - thickness), color);
+    fill(cv::Rect(x1, y0 + thickness, thickness, y1 - y0 - thickness), color);
+}
+
+void Overlay::line(cv::Point p0, cv::Point p1, const unsigned char* color, int thickness)
+{
+    if (antialias)
+    {
+        cv::Rect rect(std::min(p0.x, p1.x) - thickness, std::min(p0.y, p1.y) - thickness, abs(p1.x - p0.x) + thickness * 2 + 1, abs(p1.y - p0.y) + thickness * 2 + 1);
+        if (!clip(rect))
+            return;
+
+        cv::line(image, p0, p1, cv::Scalar(color[0], color[1], color[2], 255), thickness, cv::LINE_AA);
+        return;
+    }
+
+    // keep far off keypoints from walking long lines outside the frame
+    if (!cv::clipLine(cv::Rect(-thickness, -thickness, image.cols + thickness * 2, image.rows + thickness * 2), p0, p1))
+        return;
+
+    {
+        cv::Rect rect(std::min(p0.x, p1.x) - thickness / 2, std::min(p0.y, p1.y) - thickness / 2, abs(p1.x - p0.x) + thickness, abs(p1.y - p0.y) + thickness);
+        if (!clip(rect))
+            return;
+    }
+
+    // bresenham with a square brush
+    const cv::Rect bounds(0, 0, image.cols, image.rows);
+    const int dx = abs(p1.x - p0.x);
+    const int dy = -abs(p1.y - p0.y);
+    const int sx = p0.x < p1.x ? 1 : -1;
+    const int sy = p0.y < p1.y ? 1 : -1;
+    int err = dx + dy;
+    int x = p0.x;
+    int y = p0.y;
+    for (;;)
+    {
+        cv::Rect brush = cv::Rect(x - thickness / 2, y - thickness / 2, thickness, thickness) & bounds;
+        if (brush.width > 0 && brush.height > 0)
+            fill_clipped(brush, color);
+
+        if (x == p1.x && y == p1.y)
+            break;
+
+        int e2 = err * 2;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y += sy;
+        }
+    }
+}
+
+void Overlay::circle(cv::Point center, int radius, const unsigned char* color)
+{
+    cv::Rect rect(center.x - radius, center.y - radius, radius * 2 + 1, radius * 2 + 1);
+    if (!clip(rect))
+        return;
+
+    if (antialias)
+    {
+        cv::circle(image, center, radius, cv::Scalar(color[0], color[1], color[2], 255), -1, cv::LINE_AA);
+        return;
+    }
+
+    // one clipped span per row
+    for (int dy = -radius; dy <= radius; dy++)
+    {
+        const int y = center.y + dy;
+        if (y < rect.y || y >= rect.y + rect.height)
+            continue;
+
+        const int half = (int)sqrtf((float)(radius * radius - dy * dy) + 0.5f);
+        const int x0 = std::max(center.x - half, rect.x);
+        const int x1 = std::min(center.x + half + 1, rect.x + rect.width);
+        if (x0 < x1)
+            fill_clipped(cv::Rect(x0, y, x1 - x0, 1), color);
+    }
+}
+
+const Overlay::Glyph& Overlay::glyph(unsigned char c)
+{
+    if (c >= glyphs.size())
+        c = '?';
+
+    Glyph& g = glyphs[c];
+    if (g.advance >= 0.0)
+        return g;
+
+    // hershey glyphs have no kerning, a string advances by the sum of its glyph advances
+    const char text[2] = {(char)c, 0};
+    int baseline = 0;
+    cv::Size size = cv::getTextSize(text, font_face, font_scale, font_thickness, &baseline);
+    g.advance = size.width - font_thickness;
+
+    g.mask = cv::Mat::zeros(text_height + text_baseline + glyph_pad * 2, size.width + glyph_pad * 2, CV_8UC1);
+    cv::putText(g.mask, text, cv::Point(glyph_pad, glyph_pad + text_height), font_face, font_scale, cv::Scalar(255), font_thickness);
+
+    return g;
+}
+
+cv::Size Overlay::text_size(const char* text)
+{
+    double width = 0.0;
+    for (const char* p = text; *p; p++)
+    {
+        width += glyph((unsigned char)*p).advance;
+    }
+
+    return cv::Size((int)(width + 0.5) + font_thickness, text_height + text_baseline);
+}
+
+void Overlay::text(int x, int y, const char* text, const unsigned char* color)
+{
+    {
+        cv::Size size = text_size(text);
+        cv::Rect rect(x - glyph_pad, y - glyph_pad, size.width + glyph_pad * 2, size.height + glyph_pad * 2);
+        if (!clip(rect))
+            return;
+    }
+
+    const int cn = image.channels();
+
+    double pen = x;
+    for (const char* p = text; *p; p++)
+    {
+        const Glyph& g = glyph((unsigned char)*p);
+
+        const int gx = (int)floor(pen + 0.5) - glyph_pad;
+        const int gy = y - glyph_pad;
+        const cv::Rect rect = cv::Rect(gx, gy, g.mask.cols, g.mask.rows) & cv::Rect(0, 0, image.cols, image.rows);
+
+        for (int yy = rect.y; yy < rect.y + rect.height; yy++)
+        {
+            const unsigned char* m = g.mask.ptr<const unsigned char>(yy - gy) + (rect.x - gx);
+            unsigned char* outptr = image.ptr<unsigned char>(yy) + rect.x * cn;
+            for (int xx = 0; xx < rect.width; xx++)
+            {
+                if (m[xx])
+                {
+                    outptr[0] = color[0];
+                    outptr[1] = color[1];
+                    outptr[2] = color[2];
+                    if (cn == 4)
+                        outptr[3] = 255;
+                }
+
+                outptr += cn;
+            }
+        }
+
+        pen += g.advance;
+    }
+}
+
+void Overlay::hand(const cv::Point2f* pts)
+{
+    for (int i = 0; i < 20; i++)
+    {
+        const int* bone = hand_bones[i];
+        line(pts[bone[0]], pts[bone[1]], hand_colors[bone[2]], 2);
+    }
+
+    for (int i = 0; i < 21; i++)
+    {
+        circle(pts[i], 4, joint_color);
+    }
+}
@@ -0,0 +1,81 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// detection and hand skeleton drawing on rgb or rgba frames
+// label glyphs are rasterized once and blended from the cache afterwards,
+// lines and circles go through a fast non antialiased raster unless antialias is enabled.
+// every primitive is clipped to the frame and only touches pixels inside its bounding box
+class Overlay
+{
+public:
+    Overlay();
+
+    void set_antialias(bool antialias);
+
+    // start a frame, image has 3 or 4 channels
+    void begin(cv::Mat& image);
+
+    // finish the frame, its time is recorded by the caller under STAGE_DRAW
+    void end();
+
+    void rectangle(const cv::Rect& rect, const unsigned char* color, int thickness);
+
+    void fill(const cv::Rect& rect, const unsigned char* color);
+
+    void line(cv::Point p0, cv::Point p1, const unsigned char* color, int thickness);
+
+    // filled
+    void circle(cv::Point center, int radius, const unsigned char* color);
+
+    // size of text including the descender, as text() draws it
+    cv::Size text_size(const char* text);
+
+    // text with its top left corner at x, y
+    void text(int x, int y, const char* text, const unsigned char* color);
+
+    // 21 hand keypoints joined by the bone table
+    void hand(const cv::Point2f* pts);
+
+private:
+    struct Glyph
+    {
+        cv::Mat mask;
+        double advance;
+    };
+
+    const Glyph& glyph(unsigned char c);
+
+    // clip to the frame, false when nothing is left
+    bool clip(cv::Rect& rect);
+
+    void fill_clipped(const cv::Rect& rect, const unsigned char* color);
+
+private:
+    cv::Mat image;
+    bool antialias;
+
+    // printable ascii, rasterized on first use
+    std::vector<Glyph> glyphs;
+    int text_height;
+    int text_baseline;
+};
+
+#endif // OVERLAY_H
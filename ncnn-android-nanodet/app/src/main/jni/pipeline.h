@@ -0,0 +1,291 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tracer.h"
+
+// bounded lock-free ring for exactly one producer thread and one consumer thread
+template<typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(int capacity)
+        : slots(capacity + 1), head(0), tail(0)
+    {
+    }
+
+    // producer side, false when full
+    bool push(const T& v)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t next = h + 1 == slots.size() ? 0 : h + 1;
+        if (next == tail.load(std::memory_order_acquire))
+            return false;
+
+        slots[h] = v;
+        head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, false when empty
+    bool pop(T& v)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+
+        v = slots[t];
+        tail.store(t + 1 == slots.size() ? 0 : t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> slots;
+    // written by the producer and the consumer only, padded onto separate cache lines
+    std::atomic<size_t> head;
+    char head_pad[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+    char tail_pad[64 - sizeof(std::atomic<size_t>)];
+};
+
+// wakes a sleeping stage thread, the queues themselves never lock
+class StageSignal
+{
+public:
+    StageSignal()
+        : pending(false)
+    {
+    }
+
+    void notify()
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        pending = true;
+        cond.notify_one();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> g(mutex);
+        cond.wait(g, [this] { return pending; });
+        pending = false;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool pending;
+};
+
+// capture -> infer -> render, each stage on its own thread
+// the capture thread fills pooled frames in capture(), which hands them over to inference,
+// inference of one frame overlaps capture and conversion of the next.
+// a stage that finds several frames waiting only processes the newest one, older frames are dropped
+template<typename Frame>
+class FramePipeline
+{
+public:
+    typedef std::function<void(Frame&)> Stage;
+
+    explicit FramePipeline(int num_frames = 4)
+        : frames(num_frames), skip(num_frames), free_frames(num_frames), infer_queue(num_frames), render_queue(num_frames)
+    {
+        running = false;
+        dropped_count = 0;
+    }
+
+    ~FramePipeline()
+    {
+        stop();
+    }
+
+    // start() and stop() may run on any thread, they wait for a capture() in progress
+    void start(const Stage& _infer, const Stage& _render)
+    {
+        std::lock_guard<std::mutex> g(capture_mutex);
+
+        stop_threads();
+
+        infer = _infer;
+        render = _render;
+
+        // every frame back to the pool
+        int i;
+        while (infer_queue.pop(i)) {}
+        while (render_queue.pop(i)) {}
+        while (free_frames.pop(i)) {}
+        for (i = 0; i < (int)frames.size(); i++)
+        {
+            free_frames.push(i);
+        }
+
+        running = true;
+        infer_thread = std::thread(&FramePipeline::infer_loop, this);
+        render_thread = std::thread(&FramePipeline::render_loop, this);
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> g(capture_mutex);
+
+        stop_threads();
+    }
+
+    bool is_running() const
+    {
+        return running;
+    }
+
+    // capture thread, fill(frame) on a pooled frame and queue it for inference
+    // false when every frame is still in flight and this one has to be dropped
+    template<typename Fill>
+    bool capture(const Fill& fill)
+    {
+        // only contended by start() and stop(), which must not reset the pool under a frame being filled
+        std::lock_guard<std::mutex> g(capture_mutex);
+
+        int i;
+        if (!running || !free_frames.pop(i))
+        {
+            dropped_count++;
+            return false;
+        }
+
+        fill(frames[i]);
+
+        infer_queue.push(i);
+        infer_signal.notify();
+        return true;
+    }
+
+    // frames dropped since start, both at capture and by latest-frame-wins
+    int dropped() const
+    {
+        return dropped_count;
+    }
+
+private:
+    void stop_threads()
+    {
+        if (!running)
+            return;
+
+        running = false;
+        infer_signal.notify();
+        render_signal.notify();
+        infer_thread.join();
+        render_thread.join();
+    }
+
+    void infer_loop()
+    {
+        for (;;)
+        {
+            int i;
+            if (!infer_queue.pop(i))
+            {
+                if (!running)
+                    break;
+
+                TRACE_SCOPE("infer_wait");
+                infer_signal.wait();
+                continue;
+            }
+
+            // latest frame wins, older ones pass through render untouched back to the pool
+            int next;
+            while (infer_queue.pop(next))
+            {
+                skip[i] = 1;
+                render_queue.push(i);
+                dropped_count++;
+                i = next;
+            }
+
+            skip[i] = 0;
+            infer(frames[i]);
+
+            render_queue.push(i);
+            render_signal.notify();
+        }
+    }
+
+    void render_loop()
+    {
+        for (;;)
+        {
+            int i;
+            if (!render_queue.pop(i))
+            {
+                if (!running)
+                    break;
+
+                TRACE_SCOPE("render_wait");
+                render_signal.wait();
+                continue;
+            }
+
+            int next;
+            while (render_queue.pop(next))
+            {
+                if (!skip[i])
+                    dropped_count++;
+
+                free_frames.push(i);
+                i = next;
+            }
+
+            if (!skip[i])
+                render(frames[i]);
+
+            free_frames.push(i);
+        }
+    }
+
+private:
+    std::vector<Frame> frames;
+    // set by infer for frames it dropped, read by render
+    std::vector<char> skip;
+
+    // render -> capture
+    SpscQueue<int> free_frames;
+    // capture -> infer
+    SpscQueue<int> infer_queue;
+    // infer -> render
+    SpscQueue<int> render_queue;
+
+    StageSignal infer_signal;
+    StageSignal render_signal;
+
+    Stage infer;
+    Stage render;
+
+    // serializes capture() against start() and stop()
+    std::mutex capture_mutex;
+    std::atomic<bool> running;
+    std::atomic<int> dropped_count;
+    std::thread infer_thread;
+    std::thread render_thread;
+};
+
+#endif // PIPELINE_H
@@ -0,0 +1,153 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "tracer.h"
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#define TRACE_CAPACITY 32768
+
+struct TraceEvent
+{
+    const char* name;
+    long long ts;   // us since start()
+    int tid;
+    int frame;
+    char phase;     // 'B' or 'E'
+    std::atomic<bool> ready;
+};
+
+static TraceEvent g_events[TRACE_CAPACITY];
+static std::atomic<int> g_event_count(0);
+static std::atomic<bool> g_enabled(false);
+static std::chrono::steady_clock::time_point g_start;
+
+static thread_local int g_thread_id = 0;
+static thread_local int g_thread_frame = -1;
+
+static int thread_id()
+{
+    if (g_thread_id == 0)
+        g_thread_id = (int)syscall(SYS_gettid);
+
+    return g_thread_id;
+}
+
+static void record(const char* name, char phase)
+{
+    if (!g_enabled.load(std::memory_order_relaxed) || g_event_count.load(std::memory_order_relaxed) >= TRACE_CAPACITY)
+        return;
+
+    int i = g_event_count.fetch_add(1, std::memory_order_relaxed);
+    if (i >= TRACE_CAPACITY)
+        return;
+
+    TraceEvent& e = g_events[i];
+    e.name = name;
+    e.ts = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_start).count();
+    e.tid = thread_id();
+    e.frame = g_thread_frame;
+    e.phase = phase;
+    e.ready.store(true, std::memory_order_release);
+}
+
+void Tracer::start()
+{
+    g_enabled.store(false);
+
+    int count = std::min(g_event_count.load(), TRACE_CAPACITY);
+    for (int i = 0; i < count; i++)
+    {
+        g_events[i].ready.store(false, std::memory_order_relaxed);
+    }
+
+    g_start = std::chrono::steady_clock::now();
+    g_event_count.store(0);
+    g_enabled.store(true);
+}
+
+void Tracer::stop()
+{
+    g_enabled.store(false);
+}
+
+bool Tracer::is_enabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::set_frame(int frame)
+{
+    g_thread_frame = frame;
+}
+
+int Tracer::frame()
+{
+    return g_thread_frame;
+}
+
+void Tracer::begin(const char* name)
+{
+    record(name, 'B');
+}
+
+void Tracer::end(const char* name)
+{
+    record(name, 'E');
+}
+
+int Tracer::dump(FILE* fp)
+{
+    stop();
+
+    int count = std::min(g_event_count.load(), TRACE_CAPACITY);
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+
+    bool first = true;
+    for (int i = 0; i < count; i++)
+    {
+        const TraceEvent& e = g_events[i];
+
+        // still being written when recording stopped
+        if (!e.ready.load(std::memory_order_acquire))
+            continue;
+
+        fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":%d,\"tid\":%d,\"args\":{\"frame\":%d}}",
+                first ? "" : ",\n", e.name, e.phase, e.ts, (int)getpid(), e.tid, e.frame);
+        first = false;
+    }
+
+    fprintf(fp, "\n]}\n");
+
+    return 0;
+}
+
+int Tracer::dump(const char* path)
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp)
+        return -1;
+
+    dump(fp);
+
+    fclose(fp);
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <opencv2/core/core.hpp>
+
+#include "landmark.h"
+
+struct HandTrack
+{
+    // where the hand is looked for on the next frame
+    cv::Rect roi;
+    // detector label and score carried over between detector runs
+    int label;
+    float prob;
+    // keypoint confidence of the last update
+    float confidence;
+};
+
+// detection skipping hand tracker
+// the rois of the next frame are derived from the current 21 keypoints, so steady hands
+// only need the landmark net, the detector runs again when a hand is lost or every interval frames
+class HandTracker
+{
+public:
+    HandTracker();
+
+    // hands whose keypoint confidence drops below min_confidence are lost
+    // redetect_interval is the maximum number of tracked frames between detector runs, 0 disables tracking
+    void set_params(float min_confidence, int redetect_interval);
+
+    void reset();
+
+    float confidence_threshold() const;
+
+    // true when the next frame has to go through the detector
+    bool need_detect() const;
+
+    // hands to look for on the next frame
+    const std::vector<HandTrack>& tracks() const;
+
+    // rois, hands, labels and probs describe the frame just processed, detected tells whether rois came from the detector
+    void update(const std::vector<cv::Rect>& rois, const std::vector<HandLandmarks>& hands, const std::vector<int>& labels, const std::vector<float>& probs, bool detected, int img_w, int img_h);
+
+    // plausibility of the keypoints found in roi, from 0 to 1
+    // hand_lite-op and hand_full-op only expose handedness, so this is purely geometric
+    static float keypoint_confidence(const HandLandmarks& hand, const cv::Rect& roi);
+
+private:
+    float min_confidence;
+    int redetect_interval;
+
+    int tracked_frames;
+    bool lost;
+    std::vector<HandTrack> hand_tracks;
+};
+
+#endif // TRACKER_H
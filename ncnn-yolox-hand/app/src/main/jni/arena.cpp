@@ -0,0 +1,225 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "arena.h"
+
+#include <algorithm>
+
+// block header in front of every block, keeps the blocks aligned
+#define ARENA_ALIGN 64
+
+// the first chunk, later ones double
+#define ARENA_CHUNK_SIZE (1024 * 1024)
+
+struct BlockHeader
+{
+    size_t size;
+    int bin;
+};
+
+// four classes per power of two, at most 25% slack
+static int size_class(size_t size, size_t& class_size)
+{
+    if (size <= 64)
+    {
+        class_size = 64;
+        return 0;
+    }
+
+    size_t base = 64;
+    int bin = 0;
+    while (base * 2 < size)
+    {
+        base *= 2;
+        bin += 4;
+    }
+
+    const size_t step = base / 4;
+    const size_t m = (size - base + step - 1) / step;
+
+    class_size = base + m * step;
+    return bin + (int)m;
+}
+
+static size_t align_size(size_t size, size_t n)
+{
+    return (size + n - 1) & -n;
+}
+
+ArenaAllocator::ArenaAllocator()
+{
+    current = 0;
+    peak = 0;
+    reserved = 0;
+    outstanding = 0;
+}
+
+ArenaAllocator::~ArenaAllocator()
+{
+    release_chunks();
+}
+
+void* ArenaAllocator::fastMalloc(size_t size)
+{
+    size_t class_size;
+    int bin = size_class(size, class_size);
+    if (bin >= ARENA_BIN_COUNT)
+        return 0;
+
+    unsigned char* block;
+    if (!bins[bin].empty())
+    {
+        block = bins[bin].back();
+        bins[bin].pop_back();
+    }
+    else
+    {
+        block = carve(ARENA_ALIGN + class_size);
+        if (!block)
+            return 0;
+    }
+
+    BlockHeader* header = (BlockHeader*)block;
+    header->size = class_size;
+    header->bin = bin;
+
+    current += class_size;
+    peak = std::max(peak, current);
+    outstanding++;
+
+    return block + ARENA_ALIGN;
+}
+
+void ArenaAllocator::fastFree(void* ptr)
+{
+    unsigned char* block = (unsigned char*)ptr - ARENA_ALIGN;
+    const BlockHeader* header = (const BlockHeader*)block;
+
+    current -= header->size;
+    outstanding--;
+
+    bins[header->bin].push_back(block);
+}
+
+void ArenaAllocator::reset()
+{
+    if (outstanding != 0)
+        return;
+
+    // the free lists keep their capacity
+    for (int i = 0; i < ARENA_BIN_COUNT; i++)
+    {
+        bins[i].clear();
+    }
+
+    if (chunks.size() > 1)
+    {
+        // one chunk as large as all of them, the next frame fits without growing
+        size_t size = reserved;
+        release_chunks();
+        carve(size);
+    }
+
+    if (!chunks.empty())
+        chunks[0].used = 0;
+}
+
+size_t ArenaAllocator::current_bytes() const
+{
+    return current;
+}
+
+size_t ArenaAllocator::peak_bytes() const
+{
+    return peak;
+}
+
+size_t ArenaAllocator::reserved_bytes() const
+{
+    return reserved;
+}
+
+unsigned char* ArenaAllocator::carve(size_t size)
+{
+    size = align_size(size, ARENA_ALIGN);
+
+    if (chunks.empty() || chunks.back().size - chunks.back().used < size)
+    {
+        Chunk chunk;
+        chunk.size = std::max(size, chunks.empty() ? (size_t)ARENA_CHUNK_SIZE : chunks.back().size * 2);
+        chunk.used = 0;
+        // aligned up front by hand, over allocated by one alignment
+        chunk.data = (unsigned char*)ncnn::fastMalloc(chunk.size + ARENA_ALIGN);
+        if (!chunk.data)
+            return 0;
+
+        chunks.push_back(chunk);
+        reserved += chunk.size;
+    }
+
+    Chunk& chunk = chunks.back();
+
+    unsigned char* base = (unsigned char*)align_size((size_t)chunk.data, ARENA_ALIGN);
+    unsigned char* block = base + chunk.used;
+    chunk.used += size;
+
+    return block;
+}
+
+void ArenaAllocator::release_chunks()
+{
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        ncnn::fastFree(chunks[i].data);
+    }
+
+    chunks.clear();
+    reserved = 0;
+}
+
+void* LockedArenaAllocator::fastMalloc(size_t size)
+{
+    ncnn::MutexLockGuard g(lock);
+    return ArenaAllocator::fastMalloc(size);
+}
+
+void LockedArenaAllocator::fastFree(void* ptr)
+{
+    ncnn::MutexLockGuard g(lock);
+    ArenaAllocator::fastFree(ptr);
+}
+
+void LockedArenaAllocator::reset()
+{
+    ncnn::MutexLockGuard g(lock);
+    ArenaAllocator::reset();
+}
+
+size_t LockedArenaAllocator::current_bytes() const
+{
+    ncnn::MutexLockGuard g(lock);
+    return ArenaAllocator::current_bytes();
+}
+
+size_t LockedArenaAllocator::peak_bytes() const
+{
+    ncnn::MutexLockGuard g(lock);
+    return ArenaAllocator::peak_bytes();
+}
+
+size_t LockedArenaAllocator::reserved_bytes() const
+{
+    ncnn::MutexLockGuard g(lock);
+    return ArenaAllocator::reserved_bytes();
+}
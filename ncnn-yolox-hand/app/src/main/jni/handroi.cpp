@@ -0,0 +1,101 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "handroi.h"
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif // __ARM_NEON
+
+void hand_roi_to_input(const unsigned char* rgb, int stride, int roi_x, int roi_y, int roi_w, int roi_h, int target_size,
+                       std::vector<unsigned char>& resized, ncnn::Mat& in_pad, float& scale, int& wpad, int& hpad)
+{
+    int w = roi_w;
+    int h = roi_h;
+    scale = 1.f;
+    if (w > h)
+    {
+        scale = (float)target_size / w;
+        w = target_size;
+        h = h * scale;
+    }
+    else
+    {
+        scale = (float)target_size / h;
+        h = target_size;
+        w = w * scale;
+    }
+
+    // the roi is read in place through the frame stride, the hand region is never copied
+    const unsigned char* pixels = rgb + roi_y * stride + roi_x * 3;
+    if ((w != roi_w || h != roi_h) && w > 0 && h > 0)
+    {
+        // the fixed point bilinear behind from_pixels_resize, into the scratch
+        resized.resize(w * h * 3);
+        ncnn::resize_bilinear_c3(pixels, roi_w, roi_h, stride, &resized[0], w, h, w * 3);
+
+        pixels = &resized[0];
+        stride = w * 3;
+    }
+
+    wpad = target_size - w;
+    hpad = target_size - h;
+
+    // center into in_pad, deinterleave, zero border and 1/255 in the same pass
+    in_pad.create(target_size, target_size, 3);
+    for (int q = 0; q < 3; q++)
+    {
+        in_pad.channel(q).fill(0.f);
+    }
+
+    const float norm = 1 / 255.f;
+    for (int y = 0; y < h; y++)
+    {
+        const unsigned char* ptr = pixels + y * stride;
+        float* outptr0 = in_pad.channel(0).row(y + hpad / 2) + wpad / 2;
+        float* outptr1 = in_pad.channel(1).row(y + hpad / 2) + wpad / 2;
+        float* outptr2 = in_pad.channel(2).row(y + hpad / 2) + wpad / 2;
+
+        int x = 0;
+#if __ARM_NEON
+        float32x4_t _norm = vdupq_n_f32(norm);
+        for (; x + 7 < w; x += 8)
+        {
+            uint8x8x3_t _rgb = vld3_u8(ptr);
+            uint16x8_t _r = vmovl_u8(_rgb.val[0]);
+            uint16x8_t _g = vmovl_u8(_rgb.val[1]);
+            uint16x8_t _b = vmovl_u8(_rgb.val[2]);
+
+            vst1q_f32(outptr0, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(_r))), _norm));
+            vst1q_f32(outptr0 + 4, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(_r))), _norm));
+            vst1q_f32(outptr1, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(_g))), _norm));
+            vst1q_f32(outptr1 + 4, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(_g))), _norm));
+            vst1q_f32(outptr2, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(_b))), _norm));
+            vst1q_f32(outptr2 + 4, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(_b))), _norm));
+
+            ptr += 24;
+            outptr0 += 8;
+            outptr1 += 8;
+            outptr2 += 8;
+        }
+#endif // __ARM_NEON
+        for (; x < w; x++)
+        {
+            *outptr0++ = ptr[0] * norm;
+            *outptr1++ = ptr[1] * norm;
+            *outptr2++ = ptr[2] * norm;
+            ptr += 3;
+        }
+    }
+}
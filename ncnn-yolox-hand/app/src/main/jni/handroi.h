@@ -0,0 +1,30 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef HANDROI_H
+#define HANDROI_H
+
+#include <vector>
+
+#include <mat.h>
+
+// landmark net input for the hand at roi of a packed rgb frame, the roi is read in place through stride
+// it is scaled to fit target_size x target_size keeping its aspect, with the bilinear of from_pixels_resize,
+// then centered with a zero border, deinterleaved and scaled by 1/255 in one pass into in_pad
+// resized is scratch for the downscaled roi, keep it across frames
+// scale, wpad and hpad map net points back: x = (px - wpad / 2) / scale + roi_x
+void hand_roi_to_input(const unsigned char* rgb, int stride, int roi_x, int roi_y, int roi_w, int roi_h, int target_size,
+                       std::vector<unsigned char>& resized, ncnn::Mat& in_pad, float& scale, int& wpad, int& hpad);
+
+#endif // HANDROI_H
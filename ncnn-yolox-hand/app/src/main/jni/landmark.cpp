@@ -18,11 +18,40 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "benchmark.h"
 #include "cpu.h"
 
+#include "handroi.h"
+#include "profiler.h"
 
 
-int LandmarkDetect::load(AAssetManager* mgr, const char* modeltype, bool use_gpu)
+
+int LandmarkModel::load(const char* modeltype, bool use_gpu)
+{
+    landmark.clear();
+
+    ncnn::set_cpu_powersave(2);
+    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
+
+    landmark.opt = ncnn::Option();
+
+#if NCNN_VULKAN
+    landmark.opt.use_vulkan_compute = use_gpu;
+#endif
+
+    landmark.opt.num_threads = ncnn::get_big_cpu_count();
+    // sessions bring their own blob and workspace allocators
+
+    char parampath[256];
+    char modelpath[256];
+    sprintf(parampath, "%s.param", modeltype);
+    sprintf(modelpath, "%s.bin", modeltype);
+
+    return load_mapped(landmark, parampath, modelpath, model_file);
+}
+
+#if __ANDROID_API__ >= 9
+int LandmarkModel::load(AAssetManager* mgr, const char* modeltype, bool use_gpu)
 {
     landmark.clear();
 
@@ -36,50 +65,195 @@ int LandmarkDetect::load(AAssetManager* mgr, const char* modeltype, bool use_gpu
 #endif
 
     landmark.opt.num_threads = ncnn::get_big_cpu_count();
+    // sessions bring their own blob and workspace allocators
 
     char parampath[256];
     char modelpath[256];
     sprintf(parampath, "%s.param", modeltype);
     sprintf(modelpath, "%s.bin", modeltype);
 
-    landmark.load_param(mgr, parampath);
-    landmark.load_model(mgr, modelpath);
+    return load_mapped(landmark, mgr, parampath, modelpath, model_file);
+}
+#endif // __ANDROID_API__ >= 9
+
+LandmarkDetect::LandmarkDetect()
+{
+    num_threads = ncnn::get_big_cpu_count();
+}
+
+int LandmarkDetect::load(const char* modeltype, bool use_gpu)
+{
+    std::shared_ptr<LandmarkModel> m = std::make_shared<LandmarkModel>();
+    int ret = m->load(modeltype, use_gpu);
+
+    set_model(m);
+
+    return ret;
+}
+
+#if __ANDROID_API__ >= 9
+int LandmarkDetect::load(AAssetManager* mgr, const char* modeltype, bool use_gpu)
+{
+    std::shared_ptr<LandmarkModel> m = std::make_shared<LandmarkModel>();
+    int ret = m->load(mgr, modeltype, use_gpu);
+
+    set_model(m);
+
+    return ret;
+}
+#endif // __ANDROID_API__ >= 9
+
+void LandmarkDetect::set_model(const std::shared_ptr<const LandmarkModel>& _model)
+{
+    model = _model;
+}
+
+void LandmarkDetect::set_num_threads(int _num_threads)
+{
+    num_threads = _num_threads;
+}
+
+float LandmarkDetect::detect(const cv::Mat& rgb, const cv::Rect& box, HandLandmarks& hand)
+{
+    const int target_size = 224;
+
+    hand.score = 0.f;
 
+    if (!model)
+        return 0.f;
 
+    if (batch.c < 3)
+    {
+        batch.create(target_size, target_size, 3);
+        if (batch.empty())
+            return 0.f;
+    }
+
+    reserve_slots(1);
+
+    ncnn::Mat in_pad = batch.channel_range(0, 3);
+    detect_one(rgb, box, in_pad, num_threads, *slots[0], hand);
+
+    end_frame(1);
+
+    return hand.score;
+}
+
+int LandmarkDetect::detect(const cv::Mat& rgb, const std::vector<cv::Rect>& boxes, std::vector<HandLandmarks>& hands)
+{
+    const int target_size = 224;
+    const int n = boxes.size();
+
+    hands.resize(n);
+    if (n == 0)
+        return 0;
+
+    if (!model)
+        return -1;
+
+    PROFILE_STAGE(STAGE_LANDMARK);
+
+    if (batch.c < n * 3)
+    {
+        batch.create(target_size, target_size, n * 3);
+        if (batch.empty())
+            return -100;
+    }
+
+    reserve_slots(n);
+
+    if (n == 1 || num_threads == 1)
+    {
+        // a single hand keeps all threads inside the net, a single thread takes the hands in turn
+        // rather than through a one thread openmp team
+        for (int i = 0; i < n; i++)
+        {
+            ncnn::Mat in_pad = batch.channel_range(i * 3, 3);
+            detect_one(rgb, boxes[i], in_pad, num_threads, *slots[i], hands[i]);
+        }
+
+        end_frame(n);
+        return 0;
+    }
+
+    // one single threaded extractor and slot per hand
+    #pragma omp parallel for num_threads(std::min(n, num_threads))
+    for (int i = 0; i < n; i++)
+    {
+        ncnn::Mat in_pad = batch.channel_range(i * 3, 3);
+        detect_one(rgb, boxes[i], in_pad, 1, *slots[i], hands[i]);
+    }
+
+    end_frame(n);
     return 0;
 }
 
-float LandmarkDetect::detect(const cv::Mat& rgb,const cv::Rect& box, std::vector<cv::Point2f> &landmarks)
+double LandmarkDetect::warmup(int max_hands)
 {
-    cv::Mat input = rgb(box).clone();
-    int target_size = 224;
-    int w = input.cols;
-    int h = input.rows;
-    float scale = 1.f;
-    if (w > h)
+    // nothing loaded
+    if (!model || model->landmark.layers().empty())
+        return 0.0;
+
+    double start = ncnn::get_current_time();
+
+    const int target_size = 224;
+    cv::Mat blank = cv::Mat::zeros(target_size, target_size, CV_8UC3);
+
+    std::vector<cv::Rect> boxes;
+    std::vector<HandLandmarks> hands;
+    for (int n = 1; n <= max_hands; n++)
     {
-        scale = (float)target_size / w;
-        w = target_size;
-        h = h * scale;
+        boxes.assign(n, cv::Rect(0, 0, target_size, target_size));
+        detect(blank, boxes, hands);
     }
-    else
+
+    return ncnn::get_current_time() - start;
+}
+
+void LandmarkDetect::get_arena_usage(size_t& current_bytes, size_t& peak_bytes) const
+{
+    current_bytes = 0;
+    peak_bytes = 0;
+    for (size_t i = 0; i < slots.size(); i++)
     {
-        scale = (float)target_size / h;
-        h = target_size;
-        w = w * scale;
+        current_bytes += slots[i]->blob_allocator.current_bytes() + slots[i]->workspace_allocator.current_bytes();
+        peak_bytes += slots[i]->blob_allocator.peak_bytes() + slots[i]->workspace_allocator.peak_bytes();
     }
+}
 
-    ncnn::Mat in = ncnn::Mat::from_pixels_resize(input.data, ncnn::Mat::PIXEL_RGB, input.cols, input.rows, w, h);
-    int wpad = target_size - w;
-    int hpad = target_size - h;
-    ncnn::Mat in_pad;
-    ncnn::copy_make_border(in, in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 0.f);
+void LandmarkDetect::reserve_slots(int n)
+{
+    while ((int)slots.size() < n)
+    {
+        slots.push_back(std::make_shared<HandSlot>());
+    }
+}
+
+void LandmarkDetect::end_frame(int n)
+{
+    // detect_one released all its blobs, hand every block back at once
+    for (int i = 0; i < n; i++)
+    {
+        slots[i]->blob_allocator.reset();
+        slots[i]->workspace_allocator.reset();
+    }
+}
+
+int LandmarkDetect::detect_one(const cv::Mat& rgb, const cv::Rect& box, ncnn::Mat& in_pad, int num_threads, HandSlot& slot, HandLandmarks& hand)
+{
+    // in place, the hand region is never copied
+    float scale;
+    int wpad;
+    int hpad;
+    hand_roi_to_input(rgb.data, (int)rgb.step[0], box.x, box.y, box.width, box.height, 224, slot.resized, in_pad, scale, wpad, hpad);
 
-    const float norm_vals[3] = { 1 / 255.f, 1 / 255.f, 1 / 255.f };
-    in_pad.substract_mean_normalize(NULL, norm_vals);
     ncnn::Mat points,score;
     {
-        ncnn::Extractor ex = landmark.create_extractor();
+        // the only heap allocations left in a steady state frame are the extractor and its forward pass, see benchmark/alloc.cpp
+        ncnn::Extractor ex = model->landmark.create_extractor();
+        ex.set_num_threads(num_threads);
+        ex.set_blob_allocator(&slot.blob_allocator);
+        ex.set_workspace_allocator(&slot.workspace_allocator);
         ex.input("input", in_pad);
         ex.extract("points", points);
         ex.extract("score",score);
@@ -89,12 +263,10 @@ float LandmarkDetect::detect(const cv::Mat& rgb,const cv::Rect& box, std::vector
     float* score_data = (float*)score.data;
     for (int i = 0; i < 21; i++)
     {
-        cv::Point2f pt;
-        pt.x = (points_data[i * 3] - (wpad / 2)) / scale+(float)box.x;
-        pt.y = (points_data[i * 3 + 1]- (hpad / 2)) / scale+(float)box.y;
-
-        landmarks.push_back(pt);
+        hand.pts[i].x = (points_data[i * 3] - (wpad / 2)) / scale+(float)box.x;
+        hand.pts[i].y = (points_data[i * 3 + 1]- (hpad / 2)) / scale+(float)box.y;
     }
-    return score_data[0];
-}
+    hand.score = score_data[0];
 
+    return 0;
+}
@@ -0,0 +1,177 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "modelfile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+MappedFile::MappedFile()
+{
+    ptr = 0;
+    len = 0;
+    map = 0;
+#if __ANDROID_API__ >= 9
+    asset = 0;
+#endif // __ANDROID_API__ >= 9
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+int MappedFile::open(const char* path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+
+    // private pages, a layer writing to its weights gets its own copy instead of touching the file
+    void* p = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (p == MAP_FAILED)
+        return -1;
+
+    map = p;
+    ptr = (const unsigned char*)p;
+    len = st.st_size;
+
+    return 0;
+}
+
+#if __ANDROID_API__ >= 9
+int MappedFile::open(AAssetManager* mgr, const char* path)
+{
+    close();
+
+    asset = AAssetManager_open(mgr, path, AASSET_MODE_BUFFER);
+    if (!asset)
+        return -1;
+
+    // compressed assets get inflated into a buffer owned by the asset, still one copy less than the ncnn loader
+    const void* buffer = AAsset_getBuffer(asset);
+    if (!buffer)
+    {
+        close();
+        return -1;
+    }
+
+    ptr = (const unsigned char*)buffer;
+    len = AAsset_getLength(asset);
+
+    return 0;
+}
+#endif // __ANDROID_API__ >= 9
+
+void MappedFile::close()
+{
+    if (map)
+    {
+        munmap(map, len);
+        map = 0;
+    }
+
+#if __ANDROID_API__ >= 9
+    if (asset)
+    {
+        AAsset_close(asset);
+        asset = 0;
+    }
+#endif // __ANDROID_API__ >= 9
+
+    ptr = 0;
+    len = 0;
+}
+
+const unsigned char* MappedFile::data() const
+{
+    return ptr;
+}
+
+size_t MappedFile::size() const
+{
+    return len;
+}
+
+static bool weight_mapping = true;
+
+void set_weight_mapping(bool enabled)
+{
+    weight_mapping = enabled;
+}
+
+static int load_from_mappings(ncnn::Net& net, const MappedFile& param, const MappedFile& model)
+{
+    // the param text is a few kilobytes, parse it from a null terminated copy and let the mapping go
+    std::string text((const char*)param.data(), param.size());
+    int ret = net.load_param_mem(text.c_str());
+    if (ret != 0)
+        return ret;
+
+    return net.load_model(model.data()) > 0 ? 0 : -1;
+}
+
+int load_mapped(ncnn::Net& net, const char* parampath, const char* modelpath, MappedFile& model)
+{
+    MappedFile param;
+
+    // ncnn only references weights in place when they are 32bit aligned
+    if (weight_mapping && param.open(parampath) == 0 && model.open(modelpath) == 0 && ((size_t)model.data() & 3) == 0)
+    {
+        return load_from_mappings(net, param, model);
+    }
+
+    model.close();
+
+    int ret = net.load_param(parampath);
+    if (ret != 0)
+        return ret;
+
+    return net.load_model(modelpath);
+}
+
+#if __ANDROID_API__ >= 9
+int load_mapped(ncnn::Net& net, AAssetManager* mgr, const char* parampath, const char* modelpath, MappedFile& model)
+{
+    MappedFile param;
+
+    if (weight_mapping && param.open(mgr, parampath) == 0 && model.open(mgr, modelpath) == 0 && ((size_t)model.data() & 3) == 0)
+    {
+        return load_from_mappings(net, param, model);
+    }
+
+    model.close();
+
+    int ret = net.load_param(mgr, parampath);
+    if (ret != 0)
+        return ret;
+
+    return net.load_model(mgr, modelpath);
+}
+#endif // __ANDROID_API__ >= 9
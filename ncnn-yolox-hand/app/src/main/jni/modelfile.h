@@ -0,0 +1,69 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef MODELFILE_H
+#define MODELFILE_H
+
+#include <stddef.h>
+
+#include <net.h>
+
+// a read only mapping of a model file
+// nets loaded from it point their weights into the mapping, keep it open while the net is loaded
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // plain file through mmap
+    int open(const char* path);
+
+#if __ANDROID_API__ >= 9
+    // asset buffer, a mapping of the apk itself when the asset is stored uncompressed
+    int open(AAssetManager* mgr, const char* path);
+#endif // __ANDROID_API__ >= 9
+
+    void close();
+
+    const unsigned char* data() const;
+    size_t size() const;
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const unsigned char* ptr;
+    size_t len;
+
+    // mmap of a plain file
+    void* map;
+#if __ANDROID_API__ >= 9
+    AAsset* asset;
+#endif // __ANDROID_API__ >= 9
+};
+
+// off makes load_mapped() take the copying ncnn loaders, for comparing both, set it before loading
+void set_weight_mapping(bool enabled);
+
+// load net from parampath and modelpath with the weights referenced in place
+// falls back to the copying ncnn loaders when the files cannot be mapped or the weights are not 32bit aligned
+// model holds the weight mapping afterwards, clear the net before it is closed or reused
+int load_mapped(ncnn::Net& net, const char* parampath, const char* modelpath, MappedFile& model);
+
+#if __ANDROID_API__ >= 9
+int load_mapped(ncnn::Net& net, AAssetManager* mgr, const char* parampath, const char* modelpath, MappedFile& model);
+#endif // __ANDROID_API__ >= 9
+
+#endif // MODELFILE_H
@@ -20,7 +20,10 @@
 
 #include <opencv2/core/core.hpp>
 
-#include "mat.h"
+#include "blit.h"
+#include "nv21.h"
+#include "profiler.h"
+#include "tracer.h"
 
 static void onDisconnected(void* context, ACameraDevice* device)
 {
@@ -36,6 +39,11 @@ static void onImageAvailable(void* context, AImageReader* reader)
 {
 //     __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "onImageAvailable %p", reader);
 
+    // the camera callbacks come from a single thread
+    static int frame_number = 0;
+    TRACE_FRAME(frame_number++);
+    TRACE_SCOPE("camera_image");
+
     AImage* image = 0;
     media_status_t status = AImageReader_acquireLatestImage(reader, &image);
 
@@ -86,42 +94,14 @@ static void onImageAvailable(void* context, AImageReader* reader)
     }
     else
     {
-        // construct nv21
-        unsigned char* nv21 = new unsigned char[width * height + width * height / 2];
-        {
-            // Y
-            unsigned char* yptr = nv21;
-            for (int y=0; y<height; y++)
-            {
-                const unsigned char* y_data_ptr = y_data + y_rowStride * y;
-                for (int x=0; x<width; x++)
-                {
-                    yptr[0] = y_data_ptr[0];
-                    yptr++;
-                    y_data_ptr += y_pixelStride;
-                }
-            }
+        // construct nv21 in the buffer kept by the camera
+        NdkCamera* camera = (NdkCamera*)context;
+        unsigned char* nv21 = camera->get_nv21_buffer(width, height);
 
-            // UV
-            unsigned char* uvptr = nv21 + width * height;
-            for (int y=0; y<height/2; y++)
-            {
-                const unsigned char* v_data_ptr = v_data + v_rowStride * y;
-                const unsigned char* u_data_ptr = u_data + u_rowStride * y;
-                for (int x=0; x<width/2; x++)
-                {
-                    uvptr[0] = v_data_ptr[0];
-                    uvptr[1] = u_data_ptr[0];
-                    uvptr += 2;
-                    v_data_ptr += v_pixelStride;
-                    u_data_ptr += u_pixelStride;
-                }
-            }
-        }
-
-        ((NdkCamera*)context)->on_image((unsigned char*)nv21, (int)width, (int)height);
+        TRACE_SCOPE("repack_nv21");
+        yuv420_to_nv21(y_data, y_rowStride, y_pixelStride, u_data, u_rowStride, u_pixelStride, v_data, v_rowStride, v_pixelStride, width, height, nv21);
 
-        delete[] nv21;
+        camera->on_image(nv21, (int)width, (int)height);
     }
 
     AImage_delete(image);
@@ -182,6 +162,13 @@ NdkCamera::NdkCamera()
     {
         AImageReader_new(640, 480, AIMAGE_FORMAT_YUV_420_888, /*maxImages*/2, &image_reader);
 
+        // frames are repacked one at a time on the listener thread, one buffer serves them all
+        int32_t width = 0;
+        int32_t height = 0;
+        AImageReader_getWidth(image_reader, &width);
+        AImageReader_getHeight(image_reader, &height);
+        nv21_buffer.resize(width * height + width * height / 2);
+
         AImageReader_ImageListener listener;
         listener.context = this;
         listener.onImageAvailable = onImageAvailable;
@@ -372,6 +359,15 @@ void NdkCamera::close()
     }
 }
 
+unsigned char* NdkCamera::get_nv21_buffer(int width, int height)
+{
+    const size_t size = width * height + width * height / 2;
+    if (nv21_buffer.size() < size)
+        nv21_buffer.resize(size);
+
+    return nv21_buffer.data();
+}
+
 void NdkCamera::on_image(const cv::Mat& rgb) const
 {
 }
@@ -409,14 +405,14 @@ void NdkCamera::on_image(const unsigned char* nv21, int nv21_width, int nv21_hei
         }
     }
 
-    cv::Mat nv21_rotated(h + h / 2, w, CV_8UC1);
-    ncnn::kanna_rotate_yuv420sp(nv21, nv21_width, nv21_height, nv21_rotated.data, w, h, rotate_type);
-
-    // nv21_rotated to rgb
-    cv::Mat rgb(h, w, CV_8UC3);
-    ncnn::yuv420sp2rgb(nv21_rotated.data, w, h, rgb.data);
+    // rotate and convert to rgb in one pass
+    rgb_buffer.create(h, w, CV_8UC3);
+    {
+        PROFILE_STAGE(STAGE_CAMERA);
+        nv21_roi_rotate_to_rgb(nv21, nv21_width, nv21_height, 0, 0, nv21_width, nv21_height, rotate_type, rgb_buffer.data, (int)rgb_buffer.step[0]);
+    }
 
-    on_image(rgb);
+    on_image(rgb_buffer);
 }
 
 static const int NDKCAMERAWINDOW_ID = 233;
@@ -471,6 +467,29 @@ void NdkCameraWindow::on_image_render(cv::Mat& rgb) const
 {
 }
 
+void NdkCameraWindow::on_image_render_rgba(cv::Mat& rgba) const
+{
+}
+
+void NdkCameraWindow::on_image_nv21(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, int render_rotate_type) const
+{
+    // crop, rotate and convert nv21 to rgb in one pass
+    rgb_buffer.create(rotate_type <= 4 ? roi_h : roi_w, rotate_type <= 4 ? roi_w : roi_h, CV_8UC3);
+    {
+        PROFILE_STAGE(STAGE_CAMERA);
+        nv21_roi_rotate_to_rgb(nv21, nv21_width, nv21_height, roi_x, roi_y, roi_w, roi_h, rotate_type, rgb_buffer.data, (int)rgb_buffer.step[0]);
+    }
+
+    on_image_rgb(rgb_buffer, render_rotate_type);
+}
+
+void NdkCameraWindow::on_image_rgb(cv::Mat& rgb, int render_rotate_type) const
+{
+    on_image_render(rgb);
+
+    render(rgb, render_rotate_type);
+}
+
 void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const
 {
     // resolve orientation from camera_orientation and accelerometer_sensor
@@ -482,6 +501,8 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
             ASensorEventQueue_enableSensor(sensor_event_queue, accelerometer_sensor);
         }
 
+        TRACE_SCOPE("sensor_poll");
+
         int id = ALooper_pollAll(0, 0, 0, 0);
         if (id == NDKCAMERAWINDOW_ID)
         {
@@ -531,8 +552,6 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
     int roi_w = 0;
     int roi_h = 0;
     int rotate_type = 0;
-    int render_w = 0;
-    int render_h = 0;
     int render_rotate_type = 0;
     {
         int win_w = ANativeWindow_getWidth(win);
@@ -679,93 +698,51 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
 
         if (accelerometer_orientation == 0)
         {
-            render_w = roi_w;
-            render_h = roi_h;
             render_rotate_type = 1;
         }
         if (accelerometer_orientation == 90)
         {
-            render_w = roi_h;
-            render_h = roi_w;
             render_rotate_type = 8;
         }
         if (accelerometer_orientation == 180)
         {
-            render_w = roi_w;
-            render_h = roi_h;
             render_rotate_type = 3;
         }
         if (accelerometer_orientation == 270)
         {
-            render_w = roi_h;
-            render_h = roi_w;
             render_rotate_type = 6;
         }
     }
 
-    // crop and rotate nv21
-    cv::Mat nv21_croprotated(roi_h + roi_h / 2, roi_w, CV_8UC1);
-    {
-        const unsigned char* srcY = nv21 + nv21_roi_y * nv21_width + nv21_roi_x;
-        unsigned char* dstY = nv21_croprotated.data;
-        ncnn::kanna_rotate_c1(srcY, nv21_roi_w, nv21_roi_h, nv21_width, dstY, roi_w, roi_h, roi_w, rotate_type);
-
-        const unsigned char* srcUV = nv21 + nv21_width * nv21_height + nv21_roi_y * nv21_width / 2 + nv21_roi_x;
-        unsigned char* dstUV = nv21_croprotated.data + roi_w * roi_h;
-        ncnn::kanna_rotate_c2(srcUV, nv21_roi_w / 2, nv21_roi_h / 2, nv21_width, dstUV, roi_w / 2, roi_h / 2, roi_w, rotate_type);
-    }
-
-    // nv21_croprotated to rgb
-    cv::Mat rgb(roi_h, roi_w, CV_8UC3);
-    ncnn::yuv420sp2rgb(nv21_croprotated.data, roi_w, roi_h, rgb.data);
-
-    on_image_render(rgb);
+    on_image_nv21(nv21, nv21_width, nv21_height, nv21_roi_x, nv21_roi_y, nv21_roi_w, nv21_roi_h, rotate_type, render_rotate_type);
+}
 
-    // rotate to native window orientation
-    cv::Mat rgb_render(render_h, render_w, CV_8UC3);
-    ncnn::kanna_rotate_c3(rgb.data, roi_w, roi_h, rgb_render.data, render_w, render_h, render_rotate_type);
+void NdkCameraWindow::render(const cv::Mat& rgb, int render_rotate_type) const
+{
+    const int roi_w = rgb.cols;
+    const int roi_h = rgb.rows;
+    const int render_w = render_rotate_type <= 4 ? roi_w : roi_h;
+    const int render_h = render_rotate_type <= 4 ? roi_h : roi_w;
 
     ANativeWindow_setBuffersGeometry(win, render_w, render_h, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM);
 
     ANativeWindow_Buffer buf;
     ANativeWindow_lock(win, &buf, NULL);
 
-    // scale to target size
+    // rotate to native window orientation and expand to rgba straight into the window buffer
     if (buf.format == AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM || buf.format == AHARDWAREBUFFER_FORMAT_R8G8B8X8_UNORM)
     {
-        for (int y = 0; y < render_h; y++)
         {
-            const unsigned char* ptr = rgb_render.ptr<const unsigned char>(y);
-            unsigned char* outptr = (unsigned char*)buf.bits + buf.stride * 4 * y;
-
-            int x = 0;
-#if __ARM_NEON
-            for (; x + 7 < render_w; x += 8)
-            {
-                uint8x8x3_t _rgb = vld3_u8(ptr);
-                uint8x8x4_t _rgba;
-                _rgba.val[0] = _rgb.val[0];
-                _rgba.val[1] = _rgb.val[1];
-                _rgba.val[2] = _rgb.val[2];
-                _rgba.val[3] = vdup_n_u8(255);
-                vst4_u8(outptr, _rgba);
-
-                ptr += 24;
-                outptr += 32;
-            }
-#endif // __ARM_NEON
-            for (; x < render_w; x++)
-            {
-                outptr[0] = ptr[0];
-                outptr[1] = ptr[1];
-                outptr[2] = ptr[2];
-                outptr[3] = 255;
-
-                ptr += 3;
-                outptr += 4;
-            }
+            PROFILE_STAGE(STAGE_BLIT);
+            rgb_rotate_to_rgba(rgb.data, roi_w, roi_h, (int)rgb.step[0], (unsigned char*)buf.bits, render_w, render_h, buf.stride * 4, render_rotate_type);
         }
+
+        cv::Mat rgba(render_h, render_w, CV_8UC4, buf.bits, buf.stride * 4);
+        on_image_render_rgba(rgba);
     }
 
-    ANativeWindow_unlockAndPost(win);
+    {
+        TRACE_SCOPE("unlock_and_post");
+        ANativeWindow_unlockAndPost(win);
+    }
 }
@@ -23,6 +23,8 @@
 #include <camera/NdkCameraMetadata.h>
 #include <media/NdkImageReader.h>
 
+#include <vector>
+
 #include <opencv2/core/core.hpp>
 
 class NdkCamera
@@ -39,10 +41,17 @@ public:
 
     virtual void on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const;
 
+    // repack target for frames that do not arrive as nv21, allocated once from the image reader size
+    unsigned char* get_nv21_buffer(int width, int height);
+
 public:
     int camera_facing;
     int camera_orientation;
 
+protected:
+    // rgb conversion target, reused across frames
+    mutable cv::Mat rgb_buffer;
+
 private:
     ACameraManager* camera_manager;
     ACameraDevice* camera_device;
@@ -53,6 +62,8 @@ private:
     ACaptureSessionOutputContainer* capture_session_output_container;
     ACaptureSessionOutput* capture_session_output;
     ACameraCaptureSession* capture_session;
+
+    std::vector<unsigned char> nv21_buffer;
 };
 
 class NdkCameraWindow : public NdkCamera
@@ -65,8 +76,22 @@ public:
 
     virtual void on_image_render(cv::Mat& rgb) const;
 
+    // called by render() with the locked window buffer, for overlays drawn in window orientation
+    virtual void on_image_render_rgba(cv::Mat& rgba) const;
+
+    // called with the uncropped nv21 frame, the roi is in nv21 coordinates and rotate_type turns it upright
+    // the default converts the roi to rgb right away and passes it to on_image_rgb
+    // override to keep the nv21 roi and convert later, only for frames that are actually rendered
+    virtual void on_image_nv21(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, int render_rotate_type) const;
+
+    // called with the cropped and rotated rgb frame, the default runs on_image_render and render() right away
+    virtual void on_image_rgb(cv::Mat& rgb, int render_rotate_type) const;
+
     virtual void on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const;
 
+    // rotate rgb to the native window orientation and post it
+    void render(const cv::Mat& rgb, int render_rotate_type) const;
+
 public:
     mutable int accelerometer_orientation;
 
@@ -0,0 +1,418 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "nv21.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+
+static void pack_y_row(const unsigned char* y_data, int y_pixelstride, int width, unsigned char* outptr)
+{
+    if (y_pixelstride == 1)
+    {
+        memcpy(outptr, y_data, width);
+        return;
+    }
+
+    for (int x = 0; x < width; x++)
+    {
+        outptr[x] = y_data[0];
+        y_data += y_pixelstride;
+    }
+}
+
+// v and u from separate planes
+static void pack_vu_row_planar(const unsigned char* v_data, const unsigned char* u_data, int half_width, unsigned char* outptr)
+{
+    int x = 0;
+#if __ARM_NEON
+    for (; x + 15 < half_width; x += 16)
+    {
+        uint8x16x2_t _vu;
+        _vu.val[0] = vld1q_u8(v_data);
+        _vu.val[1] = vld1q_u8(u_data);
+        vst2q_u8(outptr, _vu);
+
+        v_data += 16;
+        u_data += 16;
+        outptr += 32;
+    }
+#elif __SSE2__
+    for (; x + 15 < half_width; x += 16)
+    {
+        __m128i _v = _mm_loadu_si128((const __m128i*)v_data);
+        __m128i _u = _mm_loadu_si128((const __m128i*)u_data);
+        _mm_storeu_si128((__m128i*)outptr, _mm_unpacklo_epi8(_v, _u));
+        _mm_storeu_si128((__m128i*)(outptr + 16), _mm_unpackhi_epi8(_v, _u));
+
+        v_data += 16;
+        u_data += 16;
+        outptr += 32;
+    }
+#endif
+    for (; x < half_width; x++)
+    {
+        outptr[0] = v_data[0];
+        outptr[1] = u_data[0];
+
+        v_data++;
+        u_data++;
+        outptr += 2;
+    }
+}
+
+// v and u every other byte, in whatever order the planes alias
+static void pack_vu_row_semiplanar(const unsigned char* v_data, const unsigned char* u_data, int half_width, unsigned char* outptr)
+{
+    if (u_data == v_data + 1)
+    {
+        // already vu interleaved, the last u sits one byte past the last v
+        memcpy(outptr, v_data, half_width * 2);
+        return;
+    }
+
+    int x = 0;
+#if __ARM_NEON
+    // a 32 byte load reaches one byte past the last chroma sample of its plane, keep it inside the row
+    for (; x + 16 < half_width; x += 16)
+    {
+        uint8x16x2_t _v = vld2q_u8(v_data);
+        uint8x16x2_t _u = vld2q_u8(u_data);
+        uint8x16x2_t _vu;
+        _vu.val[0] = _v.val[0];
+        _vu.val[1] = _u.val[0];
+        vst2q_u8(outptr, _vu);
+
+        v_data += 32;
+        u_data += 32;
+        outptr += 32;
+    }
+#elif __SSE2__
+    const __m128i _mask = _mm_set1_epi16(0x00ff);
+    for (; x + 8 < half_width; x += 8)
+    {
+        __m128i _v = _mm_and_si128(_mm_loadu_si128((const __m128i*)v_data), _mask);
+        __m128i _u = _mm_and_si128(_mm_loadu_si128((const __m128i*)u_data), _mask);
+        _mm_storeu_si128((__m128i*)outptr, _mm_or_si128(_v, _mm_slli_epi16(_u, 8)));
+
+        v_data += 16;
+        u_data += 16;
+        outptr += 16;
+    }
+#endif
+    for (; x < half_width; x++)
+    {
+        outptr[0] = v_data[0];
+        outptr[1] = u_data[0];
+
+        v_data += 2;
+        u_data += 2;
+        outptr += 2;
+    }
+}
+
+void yuv420_to_nv21(const unsigned char* y_data, int y_rowstride, int y_pixelstride,
+                    const unsigned char* u_data, int u_rowstride, int u_pixelstride,
+                    const unsigned char* v_data, int v_rowstride, int v_pixelstride,
+                    int width, int height, unsigned char* nv21)
+{
+    // Y
+    for (int y = 0; y < height; y++)
+    {
+        pack_y_row(y_data + y_rowstride * y, y_pixelstride, width, nv21 + width * y);
+    }
+
+    // VU
+    const int half_width = width / 2;
+    unsigned char* uvptr = nv21 + width * height;
+    for (int y = 0; y < height / 2; y++)
+    {
+        const unsigned char* v_data_ptr = v_data + v_rowstride * y;
+        const unsigned char* u_data_ptr = u_data + u_rowstride * y;
+        unsigned char* outptr = uvptr + width * y;
+
+        if (u_pixelstride == 1 && v_pixelstride == 1)
+        {
+            pack_vu_row_planar(v_data_ptr, u_data_ptr, half_width, outptr);
+        }
+        else if (u_pixelstride == 2 && v_pixelstride == 2)
+        {
+            pack_vu_row_semiplanar(v_data_ptr, u_data_ptr, half_width, outptr);
+        }
+        else
+        {
+            for (int x = 0; x < half_width; x++)
+            {
+                outptr[0] = v_data_ptr[0];
+                outptr[1] = u_data_ptr[0];
+                outptr += 2;
+                v_data_ptr += v_pixelstride;
+                u_data_ptr += u_pixelstride;
+            }
+        }
+    }
+}
+
+// offset of the rotated pixel (0, 0) in a srcw x srch plane and the offset steps along rotated x and y
+static void rotate_steps(int rotate_type, int srcw, int srch, int stride, int elemsize, int& origin, int& xstep, int& ystep)
+{
+    // source x and y of the rotated pixel (x, y) are sx0 + sxdx * x + sxdy * y and sy0 + sydx * x + sydy * y
+    int sx0 = 0;
+    int sy0 = 0;
+    int sxdx = 1;
+    int sydx = 0;
+    int sxdy = 0;
+    int sydy = 1;
+    switch (rotate_type)
+    {
+    case 2:
+        sx0 = srcw - 1;
+        sxdx = -1;
+        break;
+    case 3:
+        sx0 = srcw - 1;
+        sy0 = srch - 1;
+        sxdx = -1;
+        sydy = -1;
+        break;
+    case 4:
+        sy0 = srch - 1;
+        sydy = -1;
+        break;
+    case 5:
+        sxdx = 0;
+        sydx = 1;
+        sxdy = 1;
+        sydy = 0;
+        break;
+    case 6:
+        sy0 = srch - 1;
+        sxdx = 0;
+        sydx = -1;
+        sxdy = 1;
+        sydy = 0;
+        break;
+    case 7:
+        sx0 = srcw - 1;
+        sy0 = srch - 1;
+        sxdx = 0;
+        sydx = -1;
+        sxdy = -1;
+        sydy = 0;
+        break;
+    case 8:
+        sx0 = srcw - 1;
+        sxdx = 0;
+        sydx = 1;
+        sxdy = -1;
+        sydy = 0;
+        break;
+    default:
+        break;
+    }
+
+    origin = sy0 * stride + sx0 * elemsize;
+    xstep = sydx * stride + sxdx * elemsize;
+    ystep = sydy * stride + sxdy * elemsize;
+}
+
+#define SATURATE_CAST_UCHAR(X) (unsigned char)::std::min(::std::max((int)(X), 0), 255)
+
+void nv21_roi_rotate_to_rgb(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, unsigned char* rgb, int rgb_stride)
+{
+    const int w = rotate_type <= 4 ? roi_w : roi_h;
+    const int h = rotate_type <= 4 ? roi_h : roi_w;
+
+    const unsigned char* y_roi = nv21 + roi_y * nv21_width + roi_x;
+    const unsigned char* vu_roi = nv21 + nv21_width * nv21_height + roi_y * nv21_width / 2 + roi_x;
+
+    int y_origin;
+    int y_xstep;
+    int y_ystep;
+    rotate_steps(rotate_type, roi_w, roi_h, nv21_width, 1, y_origin, y_xstep, y_ystep);
+
+    int vu_origin;
+    int vu_xstep;
+    int vu_ystep;
+    rotate_steps(rotate_type, roi_w / 2, roi_h / 2, nv21_width, 2, vu_origin, vu_xstep, vu_ystep);
+
+#if __ARM_NEON
+    int8x8_t _v90 = vdup_n_s8(90);
+    int8x8_t _v46 = vdup_n_s8(46);
+    int8x8_t _v22 = vdup_n_s8(22);
+    int8x8_t _v113 = vdup_n_s8(113);
+    uint8x8_t _v128 = vdup_n_u8(128);
+#endif // __ARM_NEON
+
+    for (int y = 0; y + 1 < h; y += 2)
+    {
+        const unsigned char* yptr0 = y_roi + y_origin + y * y_ystep;
+        const unsigned char* yptr1 = yptr0 + y_ystep;
+        const unsigned char* vuptr = vu_roi + vu_origin + (y / 2) * vu_ystep;
+        unsigned char* rgb0 = rgb + y * rgb_stride;
+        unsigned char* rgb1 = rgb0 + rgb_stride;
+
+        int x = 0;
+#if __ARM_NEON
+        // rotate types 1~4 walk source rows forward or backward, load 8 pixels and reverse them if needed
+        if (y_xstep == 1 || y_xstep == -1)
+        {
+            for (; x + 7 < w; x += 8)
+            {
+                uint8x8_t _y0;
+                uint8x8_t _y1;
+                uint8x8_t _vu;
+                if (y_xstep == 1)
+                {
+                    _y0 = vld1_u8(yptr0);
+                    _y1 = vld1_u8(yptr1);
+                    _vu = vld1_u8(vuptr);
+                }
+                else
+                {
+                    _y0 = vrev64_u8(vld1_u8(yptr0 - 7));
+                    _y1 = vrev64_u8(vld1_u8(yptr1 - 7));
+                    _vu = vreinterpret_u8_u16(vrev64_u16(vreinterpret_u16_u8(vld1_u8(vuptr - 6))));
+                }
+
+                int16x8_t _yy0 = vreinterpretq_s16_u16(vshll_n_u8(_y0, 6));
+                int16x8_t _yy1 = vreinterpretq_s16_u16(vshll_n_u8(_y1, 6));
+
+                int8x8_t _vvuu = vreinterpret_s8_u8(vsub_u8(_vu, _v128));
+                int8x8x2_t _vvvvuuuu = vtrn_s8(_vvuu, _vvuu);
+                int8x8_t _vv = _vvvvuuuu.val[0];
+                int8x8_t _uu = _vvvvuuuu.val[1];
+
+                int16x8_t _r0 = vmlal_s8(_yy0, _vv, _v90);
+                int16x8_t _g0 = vmlsl_s8(_yy0, _vv, _v46);
+                _g0 = vmlsl_s8(_g0, _uu, _v22);
+                int16x8_t _b0 = vmlal_s8(_yy0, _uu, _v113);
+
+                int16x8_t _r1 = vmlal_s8(_yy1, _vv, _v90);
+                int16x8_t _g1 = vmlsl_s8(_yy1, _vv, _v46);
+                _g1 = vmlsl_s8(_g1, _uu, _v22);
+                int16x8_t _b1 = vmlal_s8(_yy1, _uu, _v113);
+
+                uint8x8x3_t _rgb0;
+                _rgb0.val[0] = vqshrun_n_s16(_r0, 6);
+                _rgb0.val[1] = vqshrun_n_s16(_g0, 6);
+                _rgb0.val[2] = vqshrun_n_s16(_b0, 6);
+
+                uint8x8x3_t _rgb1;
+                _rgb1.val[0] = vqshrun_n_s16(_r1, 6);
+                _rgb1.val[1] = vqshrun_n_s16(_g1, 6);
+                _rgb1.val[2] = vqshrun_n_s16(_b1, 6);
+
+                vst3_u8(rgb0, _rgb0);
+                vst3_u8(rgb1, _rgb1);
+
+                yptr0 += 8 * y_xstep;
+                yptr1 += 8 * y_xstep;
+                vuptr += 4 * vu_xstep;
+                rgb0 += 24;
+                rgb1 += 24;
+            }
+        }
+#endif // __ARM_NEON
+        for (; x + 1 < w; x += 2)
+        {
+            // R = ((Y << 6) + 90 * (V-128)) >> 6
+            // G = ((Y << 6) - 46 * (V-128) - 22 * (U-128)) >> 6
+            // B = ((Y << 6) + 113 * (U-128)) >> 6
+            int v = vuptr[0] - 128;
+            int u = vuptr[1] - 128;
+
+            int ruv = 90 * v;
+            int guv = -46 * v + -22 * u;
+            int buv = 113 * u;
+
+            int y00 = yptr0[0] << 6;
+            rgb0[0] = SATURATE_CAST_UCHAR((y00 + ruv) >> 6);
+            rgb0[1] = SATURATE_CAST_UCHAR((y00 + guv) >> 6);
+            rgb0[2] = SATURATE_CAST_UCHAR((y00 + buv) >> 6);
+
+            int y01 = yptr0[y_xstep] << 6;
+            rgb0[3] = SATURATE_CAST_UCHAR((y01 + ruv) >> 6);
+            rgb0[4] = SATURATE_CAST_UCHAR((y01 + guv) >> 6);
+            rgb0[5] = SATURATE_CAST_UCHAR((y01 + buv) >> 6);
+
+            int y10 = yptr1[0] << 6;
+            rgb1[0] = SATURATE_CAST_UCHAR((y10 + ruv) >> 6);
+            rgb1[1] = SATURATE_CAST_UCHAR((y10 + guv) >> 6);
+            rgb1[2] = SATURATE_CAST_UCHAR((y10 + buv) >> 6);
+
+            int y11 = yptr1[y_xstep] << 6;
+            rgb1[3] = SATURATE_CAST_UCHAR((y11 + ruv) >> 6);
+            rgb1[4] = SATURATE_CAST_UCHAR((y11 + guv) >> 6);
+            rgb1[5] = SATURATE_CAST_UCHAR((y11 + buv) >> 6);
+
+            yptr0 += 2 * y_xstep;
+            yptr1 += 2 * y_xstep;
+            vuptr += vu_xstep;
+            rgb0 += 6;
+            rgb1 += 6;
+        }
+    }
+}
+
+#undef SATURATE_CAST_UCHAR
+
+void nv21_unrotate_roi(int nv21_width, int nv21_height, int rotate_type, int& roi_x, int& roi_y, int& roi_w, int& roi_h)
+{
+    // rotate types 5~8 swap the axes
+    int x = roi_x;
+    int y = roi_y;
+    int w = roi_w;
+    int h = roi_h;
+    if (rotate_type >= 5)
+    {
+        std::swap(x, y);
+        std::swap(w, h);
+    }
+
+    // then mirror the axes the rotation flips, same mapping as kanna_rotate
+    bool flip_x = rotate_type == 2 || rotate_type == 3 || rotate_type == 7 || rotate_type == 8;
+    bool flip_y = rotate_type == 3 || rotate_type == 4 || rotate_type == 6 || rotate_type == 7;
+
+    roi_x = flip_x ? nv21_width - x - w : x;
+    roi_y = flip_y ? nv21_height - y - h : y;
+    roi_w = w;
+    roi_h = h;
+}
+
+void nv21_roi_copy(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, unsigned char* dst)
+{
+    const unsigned char* y_roi = nv21 + roi_y * nv21_width + roi_x;
+    for (int y = 0; y < roi_h; y++)
+    {
+        memcpy(dst, y_roi, roi_w);
+        y_roi += nv21_width;
+        dst += roi_w;
+    }
+
+    const unsigned char* vu_roi = nv21 + nv21_width * nv21_height + roi_y / 2 * nv21_width + roi_x;
+    for (int y = 0; y < roi_h / 2; y++)
+    {
+        memcpy(dst, vu_roi, roi_w);
+        vu_roi += nv21_width;
+        dst += roi_w;
+    }
+}
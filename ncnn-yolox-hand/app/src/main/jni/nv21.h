@@ -0,0 +1,37 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef NV21_H
+#define NV21_H
+
+// pack a YUV_420_888 image into nv21
+// the planes may be strided, chroma pixel stride 1 (planar) and 2 (semi-planar) take the fast paths
+void yuv420_to_nv21(const unsigned char* y_data, int y_rowstride, int y_pixelstride,
+                    const unsigned char* u_data, int u_rowstride, int u_pixelstride,
+                    const unsigned char* v_data, int v_rowstride, int v_pixelstride,
+                    int width, int height, unsigned char* nv21);
+
+// crop roi out of an nv21 frame, rotate it by rotate_type (1~8, as in ncnn kanna_rotate) and convert to rgb
+// the rgb image is the rotated roi size, roi_x roi_y roi_w roi_h must be even
+// bit exact with kanna_rotate_c1 + kanna_rotate_c2 + yuv420sp2rgb, without the intermediate nv21 image
+void nv21_roi_rotate_to_rgb(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, unsigned char* rgb, int rgb_stride);
+
+// map a roi of the rotate_type rotated frame back to nv21 coordinates, in place
+// an even roi of the rotated frame stays even when the nv21 frame size is even
+void nv21_unrotate_roi(int nv21_width, int nv21_height, int rotate_type, int& roi_x, int& roi_y, int& roi_w, int& roi_h);
+
+// copy roi out of an nv21 frame into a compact roi_w x roi_h nv21 image, roi_x roi_y roi_w roi_h must be even
+void nv21_roi_copy(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, unsigned char* dst);
+
+#endif // NV21_H
@@ -0,0 +1,103 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+
+#define PROFILE_RING_SIZE 256
+
+struct StageRing
+{
+    std::atomic<unsigned int> count;
+    std::atomic<float> samples[PROFILE_RING_SIZE];
+};
+
+static StageRing g_rings[STAGE_COUNT];
+
+void StageProfiler::record(int stage, float ms)
+{
+    if (stage < 0 || stage >= STAGE_COUNT)
+        return;
+
+    StageRing& ring = g_rings[stage];
+
+    unsigned int i = ring.count.fetch_add(1, std::memory_order_relaxed);
+    ring.samples[i % PROFILE_RING_SIZE].store(ms, std::memory_order_relaxed);
+}
+
+static float percentile(const float* sorted, int n, int p)
+{
+    // nearest rank
+    int i = (n * p + 99) / 100 - 1;
+    return sorted[std::min(std::max(i, 0), n - 1)];
+}
+
+int StageProfiler::query(int stage, float& p50, float& p95, float& p99)
+{
+    p50 = 0.f;
+    p95 = 0.f;
+    p99 = 0.f;
+
+    if (stage < 0 || stage >= STAGE_COUNT)
+        return 0;
+
+    const StageRing& ring = g_rings[stage];
+
+    int n = (int)std::min(ring.count.load(std::memory_order_relaxed), (unsigned int)PROFILE_RING_SIZE);
+    if (n == 0)
+        return 0;
+
+    float sorted[PROFILE_RING_SIZE];
+    for (int i = 0; i < n; i++)
+    {
+        sorted[i] = ring.samples[i].load(std::memory_order_relaxed);
+    }
+    std::sort(sorted, sorted + n);
+
+    p50 = percentile(sorted, n, 50);
+    p95 = percentile(sorted, n, 95);
+    p99 = percentile(sorted, n, 99);
+
+    return n;
+}
+
+void StageProfiler::reset()
+{
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        g_rings[i].count.store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* StageProfiler::name(int stage)
+{
+    static const char* names[STAGE_COUNT] =
+    {
+        "camera",
+        "preprocess",
+        "inference",
+        "decode",
+        "nms",
+        "landmark",
+        "draw",
+        "blit",
+    };
+
+    if (stage < 0 || stage >= STAGE_COUNT)
+        return "unknown";
+
+    return names[stage];
+}
@@ -0,0 +1,83 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// build with -DSTAGE_PROFILER=0 to compile every PROFILE_STAGE scope away
+#ifndef STAGE_PROFILER
+#define STAGE_PROFILER 1
+#endif
+
+#include <chrono>
+
+#include "tracer.h"
+
+enum ProfileStage
+{
+    STAGE_CAMERA = 0,   // camera frame to rgb
+    STAGE_PREPROCESS,   // letterbox resize and normalize
+    STAGE_INFERENCE,    // detector net
+    STAGE_DECODE,       // proposals from the net outputs
+    STAGE_NMS,
+    STAGE_LANDMARK,     // landmark net over all hands of a frame
+    STAGE_DRAW,
+    STAGE_BLIT,         // rgb to the window buffer
+    STAGE_COUNT
+};
+
+// per stage latency, the last 256 samples of every stage are kept in a ring
+// record() is lock free and may run on any thread, query() copies the ring and sorts the copy
+class StageProfiler
+{
+public:
+    static void record(int stage, float ms);
+
+    // percentiles in ms over the samples in the ring, returns the sample count
+    static int query(int stage, float& p50, float& p95, float& p99);
+
+    static void reset();
+
+    static const char* name(int stage);
+};
+
+// records the lifetime of the scope into stage, and into the trace when tracing
+class StageTimer
+{
+public:
+    explicit StageTimer(int _stage) : stage(_stage), trace(StageProfiler::name(_stage)), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~StageTimer()
+    {
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        StageProfiler::record(stage, elapsed.count());
+    }
+
+private:
+    int stage;
+    TraceScope trace;
+    std::chrono::steady_clock::time_point start;
+};
+
+#if STAGE_PROFILER
+#define PROFILE_STAGE_CAT2(a, b) a##b
+#define PROFILE_STAGE_CAT(a, b)  PROFILE_STAGE_CAT2(a, b)
+#define PROFILE_STAGE(stage)     StageTimer PROFILE_STAGE_CAT(stage_timer_, __LINE__)(stage)
+#else
+#define PROFILE_STAGE(stage)
+#endif
+
+#endif // PROFILER_H
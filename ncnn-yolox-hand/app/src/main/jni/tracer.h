@@ -0,0 +1,79 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TRACER_H
+#define TRACER_H
+
+// build with -DFRAME_TRACER=0 to compile every TRACE_SCOPE away
+#ifndef FRAME_TRACER
+#define FRAME_TRACER 1
+#endif
+
+#include <stdio.h>
+
+// begin/end events of named scopes with thread id and frame number, recorded into a preallocated buffer
+// recording is off until start(), events past the buffer capacity are dropped
+// names must be string literals, only the pointer is stored
+class Tracer
+{
+public:
+    // clears the buffer and starts recording
+    static void start();
+    static void stop();
+    static bool is_enabled();
+
+    // frame number attached to the events of the calling thread from now on
+    static void set_frame(int frame);
+    static int frame();
+
+    static void begin(const char* name);
+    static void end(const char* name);
+
+    // stops recording and writes chrome trace json, loadable in chrome://tracing and perfetto
+    static int dump(FILE* fp);
+    static int dump(const char* path);
+};
+
+// begin and end event around the scope
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* _name) : name(_name), enabled(Tracer::is_enabled())
+    {
+        if (enabled)
+            Tracer::begin(name);
+    }
+
+    ~TraceScope()
+    {
+        if (enabled)
+            Tracer::end(name);
+    }
+
+private:
+    const char* name;
+    bool enabled;
+};
+
+#if FRAME_TRACER
+#define TRACE_SCOPE_CAT2(a, b) a##b
+#define TRACE_SCOPE_CAT(a, b)  TRACE_SCOPE_CAT2(a, b)
+#define TRACE_SCOPE(name)      TraceScope TRACE_SCOPE_CAT(trace_scope_, __LINE__)(name)
+#define TRACE_FRAME(frame)     Tracer::set_frame(frame)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_FRAME(frame)
+#endif
+
+#endif // TRACER_H
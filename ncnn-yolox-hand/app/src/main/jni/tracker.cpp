@@ -0,0 +1,137 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "tracker.h"
+
+#include <algorithm>
+
+HandTracker::HandTracker()
+{
+    min_confidence = 0.8f;
+    redetect_interval = 10;
+
+    reset();
+}
+
+void HandTracker::set_params(float _min_confidence, int _redetect_interval)
+{
+    min_confidence = _min_confidence;
+    redetect_interval = _redetect_interval;
+}
+
+void HandTracker::reset()
+{
+    tracked_frames = 0;
+    lost = true;
+    hand_tracks.clear();
+}
+
+float HandTracker::confidence_threshold() const
+{
+    return min_confidence;
+}
+
+bool HandTracker::need_detect() const
+{
+    return lost || hand_tracks.empty() || tracked_frames >= redetect_interval;
+}
+
+const std::vector<HandTrack>& HandTracker::tracks() const
+{
+    return hand_tracks;
+}
+
+float HandTracker::keypoint_confidence(const HandLandmarks& hand, const cv::Rect& roi)
+{
+    if (roi.width <= 0 || roi.height <= 0)
+        return 0.f;
+
+    float xmin = hand.pts[0].x;
+    float ymin = hand.pts[0].y;
+    float xmax = hand.pts[0].x;
+    float ymax = hand.pts[0].y;
+    int inside = 0;
+    for (int i = 0; i < 21; i++)
+    {
+        const cv::Point2f& pt = hand.pts[i];
+        xmin = std::min(xmin, pt.x);
+        ymin = std::min(ymin, pt.y);
+        xmax = std::max(xmax, pt.x);
+        ymax = std::max(ymax, pt.y);
+
+        if (pt.x >= roi.x && pt.x < roi.x + roi.width && pt.y >= roi.y && pt.y < roi.y + roi.height)
+            inside++;
+    }
+
+    // keypoints collapsing to a blob or spreading past the roi mean the hand is gone
+    const float extent = std::max(xmax - xmin, ymax - ymin) / std::max(roi.width, roi.height);
+    if (extent < 0.25f || extent > 1.5f)
+        return 0.f;
+
+    return inside / 21.f;
+}
+
+void HandTracker::update(const std::vector<cv::Rect>& rois, const std::vector<HandLandmarks>& hands, const std::vector<int>& labels, const std::vector<float>& probs, bool detected, int img_w, int img_h)
+{
+    tracked_frames = detected ? 0 : tracked_frames + 1;
+    lost = false;
+
+    hand_tracks.clear();
+    for (size_t i = 0; i < hands.size(); i++)
+    {
+        const HandLandmarks& hand = hands[i];
+
+        const float confidence = keypoint_confidence(hand, rois[i]);
+        if (confidence < min_confidence)
+        {
+            lost = true;
+            continue;
+        }
+
+        float xmin = hand.pts[0].x;
+        float ymin = hand.pts[0].y;
+        float xmax = hand.pts[0].x;
+        float ymax = hand.pts[0].y;
+        for (int j = 1; j < 21; j++)
+        {
+            xmin = std::min(xmin, hand.pts[j].x);
+            ymin = std::min(ymin, hand.pts[j].y);
+            xmax = std::max(xmax, hand.pts[j].x);
+            ymax = std::max(ymax, hand.pts[j].y);
+        }
+
+        // keypoints hug the hand tighter than detector boxes, grow them and leave room for motion
+        const float cx = (xmin + xmax) * 0.5f;
+        const float cy = (ymin + ymax) * 0.5f;
+        const float w = (xmax - xmin) * 1.4f;
+        const float h = (ymax - ymin) * 1.4f;
+
+        int x0 = std::max((int)(cx - w * 0.5f), 0);
+        int y0 = std::max((int)(cy - h * 0.5f), 0);
+        int x1 = std::min((int)(cx + w * 0.5f), img_w - 1);
+        int y1 = std::min((int)(cy + h * 0.5f), img_h - 1);
+        if (x1 - x0 < 16 || y1 - y0 < 16)
+        {
+            lost = true;
+            continue;
+        }
+
+        HandTrack track;
+        track.roi = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+        track.label = labels[i];
+        track.prob = probs[i];
+        track.confidence = confidence;
+        hand_tracks.push_back(track);
+    }
+}
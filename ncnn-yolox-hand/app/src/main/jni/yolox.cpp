@@ -16,8 +16,11 @@
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+#include "benchmark.h"
 #include "cpu.h"
 
+#include "profiler.h"
+
 
 
 // YOLOX use the same focus in yolov5
@@ -69,103 +72,27 @@ public:
 
 DEFINE_LAYER_CREATOR(YoloV5Focus)
 
-
-struct GridAndStride
-{
-    int grid0;
-    int grid1;
-    int stride;
-};
-
-static inline float intersection_area(const Object& a, const Object& b)
-{
-    cv::Rect_<float> inter = a.rect & b.rect;
-    return inter.area();
-}
-
-static void qsort_descent_inplace(std::vector<Object>& faceobjects, int left, int right)
+static void nms_bboxes(const std::vector<Object>& objects, std::vector<int>& picked, float nms_threshold, BoxNms& nms)
 {
-    int i = left;
-    int j = right;
-    float p = faceobjects[(left + right) / 2].prob;
-
-    while (i <= j)
+    nms.clear();
+    for (size_t i = 0; i < objects.size(); i++)
     {
-        while (faceobjects[i].prob > p)
-            i++;
-
-        while (faceobjects[j].prob < p)
-            j--;
-
-        if (i <= j)
-        {
-            // swap
-            std::swap(faceobjects[i], faceobjects[j]);
-
-            i++;
-            j--;
-        }
+        const cv::Rect_<float>& rect = objects[i].rect;
+        nms.push_back(rect.x, rect.y, rect.width, rect.height, objects[i].prob);
     }
 
-    #pragma omp parallel sections
-    {
-        #pragma omp section
-        {
-            if (left < j) qsort_descent_inplace(faceobjects, left, j);
-        }
-        #pragma omp section
-        {
-            if (i < right) qsort_descent_inplace(faceobjects, i, right);
-        }
-    }
+    // ordering only touches (score, index) pairs, the top 300 are selected without a full sort
+    // a hand is covered by far fewer boxes than this, the cap only bounds pathological frames
+    nms.run(picked, nms_threshold, 300);
 }
 
-static void qsort_descent_inplace(std::vector<Object>& objects)
+static void generate_grids_and_stride(const int target_w, const int target_h, const int* strides, int num_strides, std::vector<GridAndStride>& grid_strides)
 {
-    if (objects.empty())
-        return;
-
-    qsort_descent_inplace(objects, 0, objects.size() - 1);
-}
+    grid_strides.clear();
 
-static void nms_sorted_bboxes(const std::vector<Object>& faceobjects, std::vector<int>& picked, float nms_threshold)
-{
-    picked.clear();
-
-    const int n = faceobjects.size();
-
-    std::vector<float> areas(n);
-    for (int i = 0; i < n; i++)
-    {
-        areas[i] = faceobjects[i].rect.area();
-    }
-
-    for (int i = 0; i < n; i++)
-    {
-        const Object& a = faceobjects[i];
-
-        int keep = 1;
-        for (int j = 0; j < (int)picked.size(); j++)
-        {
-            const Object& b = faceobjects[picked[j]];
-
-            // intersection over union
-            float inter_area = intersection_area(a, b);
-            float union_area = areas[i] + areas[picked[j]] - inter_area;
-            // float IoU = inter_area / union_area
-            if (inter_area / union_area > nms_threshold)
-                keep = 0;
-        }
-
-        if (keep)
-            picked.push_back(i);
-    }
-}
-
-static void generate_grids_and_stride(const int target_w, const int target_h, std::vector<int>& strides, std::vector<GridAndStride>& grid_strides)
-{
-    for (auto stride : strides)
+    for (int i = 0; i < num_strides; i++)
     {
+        const int stride = strides[i];
         int num_grid_w = target_w / stride;
         int num_grid_h = target_h / stride;
         for (int g1 = 0; g1 < num_grid_h; g1++)
@@ -182,17 +109,22 @@ static void generate_grids_and_stride(const int target_w, const int target_h, st
     }
 }
 
-static void generate_yolox_proposals(std::vector<GridAndStride> grid_strides, const ncnn::Mat& feat_blob, float prob_threshold, std::vector<Object>& objects)
+static void generate_yolox_proposals(const std::vector<GridAndStride>& grid_strides, const ncnn::Mat& feat_blob, float prob_threshold, std::vector<Object>& objects)
 {
     const int num_grid = feat_blob.h;
 
     const int num_class = feat_blob.w - 5;
 
-    const int num_anchors = grid_strides.size();
+    const int num_anchors = std::min((int)grid_strides.size(), num_grid);
 
     const float* feat_ptr = feat_blob.channel(0);
-    for (int anchor_idx = 0; anchor_idx < num_anchors; anchor_idx++)
+    for (int anchor_idx = 0; anchor_idx < num_anchors; anchor_idx++, feat_ptr += feat_blob.w)
     {
+        // class scores are sigmoid outputs in [0, 1], so box_prob can never exceed objectness
+        float box_objectness = feat_ptr[4];
+        if (box_objectness <= prob_threshold)
+            continue;
+
         const int grid0 = grid_strides[anchor_idx].grid0;
         const int grid1 = grid_strides[anchor_idx].grid1;
         const int stride = grid_strides[anchor_idx].stride;
@@ -207,7 +139,6 @@ static void generate_yolox_proposals(std::vector<GridAndStride> grid_strides, co
         float x0 = x_center - w * 0.5f;
         float y0 = y_center - h * 0.5f;
 
-        float box_objectness = feat_ptr[4];
         for (int class_idx = 0; class_idx < num_class; class_idx++)
         {
             float box_cls_score = feat_ptr[5 + class_idx];
@@ -226,7 +157,6 @@ static void generate_yolox_proposals(std::vector<GridAndStride> grid_strides, co
             }
 
         } // class loop
-        feat_ptr += feat_blob.w;
 
     } // point anchor loop
 }
@@ -234,15 +164,15 @@ static void generate_yolox_proposals(std::vector<GridAndStride> grid_strides, co
  
 Yolox::Yolox()
 {
-    blob_pool_allocator.set_size_compare_ratio(0.f);
-    workspace_pool_allocator.set_size_compare_ratio(0.f);
+    num_threads = ncnn::get_big_cpu_count();
+    target_size = 0;
+    in_w = 0;
+    in_h = 0;
 }
 
-int Yolox::load(const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
+int YoloxModel::load(const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
 {
     yolox.clear();
-    blob_pool_allocator.clear();
-    workspace_pool_allocator.clear();
 
     ncnn::set_cpu_powersave(2);
     ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
@@ -254,16 +184,21 @@ int Yolox::load(const char* modeltype, int _target_size, const float* _mean_vals
 #endif
     yolox.register_custom_layer("YoloV5Focus", YoloV5Focus_layer_creator);
     yolox.opt.num_threads = ncnn::get_big_cpu_count();
-    yolox.opt.blob_allocator = &blob_pool_allocator;
-    yolox.opt.workspace_allocator = &workspace_pool_allocator;
+    // sessions bring their own blob and workspace allocators
 
     char parampath[256];
     char modelpath[256];
     sprintf(parampath, "%s.param", modeltype);
     sprintf(modelpath, "%s.bin", modeltype);
 
-    yolox.load_param(parampath);
-    yolox.load_model(modelpath);
+    int ret = load_mapped(yolox, parampath, modelpath, model_file);
+    if (ret != 0)
+        return ret;
+
+    landmark = std::make_shared<LandmarkModel>();
+    ret = landmark->load("hand_lite-op");
+    if (ret != 0)
+        return ret;
 
     target_size = _target_size;
     mean_vals[0] = _mean_vals[0];
@@ -276,11 +211,10 @@ int Yolox::load(const char* modeltype, int _target_size, const float* _mean_vals
     return 0;
 }
 
-int Yolox::load(AAssetManager* mgr, const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
+#if __ANDROID_API__ >= 9
+int YoloxModel::load(AAssetManager* mgr, const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
 {
     yolox.clear();
-    blob_pool_allocator.clear();
-    workspace_pool_allocator.clear();
 
     ncnn::set_cpu_powersave(2);
     ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
@@ -291,18 +225,21 @@ int Yolox::load(AAssetManager* mgr, const char* modeltype, int _target_size, con
 #endif
     yolox.register_custom_layer("YoloV5Focus", YoloV5Focus_layer_creator);
     yolox.opt.num_threads = ncnn::get_big_cpu_count();
-    yolox.opt.blob_allocator = &blob_pool_allocator;
-    yolox.opt.workspace_allocator = &workspace_pool_allocator;
+    // sessions bring their own blob and workspace allocators
 
     char parampath[256];
     char modelpath[256];
     sprintf(parampath, "%s.param", modeltype);
     sprintf(modelpath, "%s.bin", modeltype);
 
-    yolox.load_param(mgr, parampath);
-    yolox.load_model(mgr, modelpath);
+    int ret = load_mapped(yolox, mgr, parampath, modelpath, model_file);
+    if (ret != 0)
+        return ret;
 
-    landmark.load(mgr,"hand_lite-op");//there are two models: hand_lite-op, hand_full-op
+    landmark = std::make_shared<LandmarkModel>();
+    ret = landmark->load(mgr,"hand_lite-op");//there are two models: hand_lite-op, hand_full-op
+    if (ret != 0)
+        return ret;
 
     target_size = _target_size;
     mean_vals[0] = _mean_vals[0];
@@ -314,18 +251,53 @@ int Yolox::load(AAssetManager* mgr, const char* modeltype, int _target_size, con
 
     return 0;
 }
+#endif // __ANDROID_API__ >= 9
 
 
-int Yolox::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+int Yolox::load(const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
 {
+    std::shared_ptr<YoloxModel> m = std::make_shared<YoloxModel>();
+    int ret = m->load(modeltype, _target_size, _mean_vals, _norm_vals, use_gpu);
 
-    int img_w = rgb.cols;
-    int img_h = rgb.rows;
+    set_model(m);
+
+    return ret;
+}
+
+#if __ANDROID_API__ >= 9
+int Yolox::load(AAssetManager* mgr, const char* modeltype, int _target_size, const float* _mean_vals, const float* _norm_vals, bool use_gpu)
+{
+    std::shared_ptr<YoloxModel> m = std::make_shared<YoloxModel>();
+    int ret = m->load(mgr, modeltype, _target_size, _mean_vals, _norm_vals, use_gpu);
+
+    set_model(m);
 
+    return ret;
+}
+#endif // __ANDROID_API__ >= 9
+
+void Yolox::set_model(const std::shared_ptr<const YoloxModel>& _model)
+{
+    model = _model;
+    landmark.set_model(model->landmark);
+
+    tracker.reset();
+
+    target_size = model->target_size;
+    mean_vals[0] = model->mean_vals[0];
+    mean_vals[1] = model->mean_vals[1];
+    mean_vals[2] = model->mean_vals[2];
+    norm_vals[0] = model->norm_vals[0];
+    norm_vals[1] = model->norm_vals[1];
+    norm_vals[2] = model->norm_vals[2];
+}
+
+static void letterbox_size(int img_w, int img_h, int target_size, int& w, int& h, float& scale)
+{
     // letterbox pad to multiple of 32
-    int w = img_w;
-    int h = img_h;
-    float scale = 1.f;
+    w = img_w;
+    h = img_h;
+    scale = 1.f;
     if (w > h)
     {
         scale = (float)target_size / w;
@@ -338,41 +310,129 @@ int Yolox::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_t
         h = target_size;
         w = w * scale;
     }
+}
+
+double Yolox::warmup()
+{
+    double start = ncnn::get_current_time();
 
-    ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB, img_w, img_h, w, h);
+    // the square frame letterboxes to the largest padded input, the arena chunks grown here
+    // fit every camera aspect since each frame carves its blocks afresh from them
+    cv::Mat blank = cv::Mat::zeros(target_size, target_size, CV_8UC3);
+    std::vector<Object> objects;
+    detect(blank, objects);
+
+    landmark.warmup();
+
+    // forget whatever the blank frame left in the tracker
+    tracker.reset();
+
+    return ncnn::get_current_time() - start;
+}
+
+int Yolox::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    int img_w = rgb.cols;
+    int img_h = rgb.rows;
+
+    int w;
+    int h;
+    float scale;
+    letterbox_size(img_w, img_h, target_size, w, h, scale);
 
     // pad to target_size rectangle
     // yolov5/utils/datasets.py letterbox
     int wpad = (w + 31) / 32 * 32 - w;
     int hpad = (h + 31) / 32 * 32 - h;
-    ncnn::Mat in_pad;
-    ncnn::copy_make_border(in, in_pad, 0, hpad, 0, wpad, ncnn::BORDER_CONSTANT, 114.f);
 
+    // resize, 114 border and mean/norm in one pass into the reused in_pad
     // so for 0-255 input image, rgb_mean should multiply 255 and norm should div by std.
-    in_pad.substract_mean_normalize(mean_vals, norm_vals);
+    {
+        PROFILE_STAGE(STAGE_PREPROCESS);
+        int ret = letterbox.resize(rgb.data, img_w, img_h, (int)rgb.step[0], false, w, h, 0, 0, w + wpad, h + hpad, 114.f, mean_vals, norm_vals, in_pad);
+        if (ret != 0)
+        {
+            objects.clear();
+            return -100;
+        }
+    }
+
+    detect_boxes(img_w, img_h, scale, objects, prob_threshold, nms_threshold);
 
-    ncnn::Extractor ex = yolox.create_extractor();
+    return detect_landmarks(rgb, objects);
+}
+
+int Yolox::detect(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    // image size after crop and rotate
+    int img_w = rotate_type <= 4 ? roi_w : roi_h;
+    int img_h = rotate_type <= 4 ? roi_h : roi_w;
+
+    int w;
+    int h;
+    float scale;
+    letterbox_size(img_w, img_h, target_size, w, h, scale);
+
+    int wpad = (w + 31) / 32 * 32 - w;
+    int hpad = (h + 31) / 32 * 32 - h;
+
+    // crop, rotate, yuv2rgb and resize while sampling, no full resolution rgb frame involved
+    {
+        PROFILE_STAGE(STAGE_PREPROCESS);
+        int ret = letterbox.resize_nv21(nv21, nv21_width, nv21_height, roi_x, roi_y, roi_w, roi_h, rotate_type, false, w, h, 0, 0, w + wpad, h + hpad, 114.f, mean_vals, norm_vals, in_pad);
+        if (ret != 0)
+        {
+            objects.clear();
+            return -100;
+        }
+    }
 
-    ex.input("input", in_pad);
+    return detect_boxes(img_w, img_h, scale, objects, prob_threshold, nms_threshold);
+}
 
-    std::vector<Object> proposals;
+int Yolox::detect_boxes(int img_w, int img_h, float scale, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    proposals.clear();
 
     {
+        // the only heap allocations left in a steady state frame are the extractor and its forward pass, see benchmark/alloc.cpp
+        ncnn::Extractor ex = model->yolox.create_extractor();
+        ex.set_num_threads(num_threads);
+        ex.set_blob_allocator(&blob_allocator);
+        ex.set_workspace_allocator(&workspace_allocator);
+
+        ex.input("input", in_pad);
+
         ncnn::Mat out;
-        ex.extract("output", out);
+        {
+            PROFILE_STAGE(STAGE_INFERENCE);
+            ex.extract("output", out);
+        }
+
+        PROFILE_STAGE(STAGE_DECODE);
+
+        // the anchor table only depends on the padded input shape
+        if (in_pad.w != in_w || in_pad.h != in_h)
+        {
+            const int strides[3] = {8, 16, 32}; // might have stride=64
+            generate_grids_and_stride(in_pad.w, in_pad.h, strides, 3, grid_strides);
+            in_w = in_pad.w;
+            in_h = in_pad.h;
+        }
 
-        std::vector<int> strides = {8, 16, 32}; // might have stride=64
-        std::vector<GridAndStride> grid_strides;
-        generate_grids_and_stride(in_pad.w,in_pad.h, strides, grid_strides);
         generate_yolox_proposals(grid_strides, out, prob_threshold, proposals);
     }
 
-    // sort all proposals by score from highest to lowest
-    qsort_descent_inplace(proposals);
+    // the extractor and every blob of this frame are gone, hand all blocks back at once
+    // so the arenas are merged and ready before the next frame
+    blob_allocator.reset();
+    workspace_allocator.reset();
 
-    // apply nms with nms_threshold
-    std::vector<int> picked;
-    nms_sorted_bboxes(proposals, picked, nms_threshold);
+    // pick proposals from highest to lowest score and apply nms with nms_threshold
+    {
+        PROFILE_STAGE(STAGE_NMS);
+        nms_bboxes(proposals, picked, nms_threshold, nms);
+    }
 
     int count = picked.size();
 
@@ -397,19 +457,141 @@ int Yolox::detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_t
         objects[i].rect.y = y0;
         objects[i].rect.width = x1 - x0;
         objects[i].rect.height = y1 - y0;
+        objects[i].track_confidence = 0.f;
+    }
+
+    return 0;
+}
+
+int Yolox::detect_landmarks(const cv::Mat& rgb, std::vector<Object>& objects)
+{
+    hand_boxes.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        hand_boxes[i] = objects[i].rect;
+    }
+
+    // every hand in one batched call
+    landmark.detect(rgb, hand_boxes, hands);
+
+    hand_labels.resize(objects.size());
+    hand_probs.resize(objects.size());
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        objects[i].label = hands[i].score > 0.3 ? 0 : 1;
+        for (int j = 0; j < 21; j++)
+            objects[i].pts[j] = hands[i].pts[j];
+
+        objects[i].track_confidence = HandTracker::keypoint_confidence(hands[i], hand_boxes[i]);
+
+        hand_labels[i] = objects[i].label;
+        hand_probs[i] = objects[i].prob;
+    }
+
+    // follow these hands on the next frames
+    tracker.update(hand_boxes, hands, hand_labels, hand_probs, true, rgb.cols, rgb.rows);
+
+    return 0;
+}
+
+int Yolox::track(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold, float nms_threshold)
+{
+    if (tracker.need_detect())
+        return detect(rgb, objects, prob_threshold, nms_threshold);
+
+    return track_landmarks(rgb, objects);
+}
+
+static void copy_result(const std::vector<Object>& objects, HandResult& result)
+{
+    result.count = std::min((int)objects.size(), (int)HandResult::max_hands);
+    for (int i = 0; i < result.count; i++)
+    {
+        result.objects[i] = objects[i];
+    }
+}
+
+int Yolox::detect(const cv::Mat& rgb, HandResult& result, float prob_threshold, float nms_threshold)
+{
+    int ret = detect(rgb, result_objects, prob_threshold, nms_threshold);
+    copy_result(result_objects, result);
+    return ret;
+}
+
+int Yolox::track(const cv::Mat& rgb, HandResult& result, float prob_threshold, float nms_threshold)
+{
+    int ret = track(rgb, result_objects, prob_threshold, nms_threshold);
+    copy_result(result_objects, result);
+    return ret;
+}
+
+bool Yolox::need_detect() const
+{
+    return tracker.need_detect();
+}
+
+int Yolox::track_landmarks(const cv::Mat& rgb, std::vector<Object>& objects)
+{
+    const std::vector<HandTrack>& tracks = tracker.tracks();
 
-        std::vector<cv::Point2f> pts;
-        float score = landmark.detect(rgb,objects[i].rect,pts);
-        objects[i].label = score > 0.3 ? 0 : 1;
-        for(int j = 0; j < pts.size(); j++)
-            objects[i].pts[j] = pts[j];
+    hand_boxes.resize(tracks.size());
+    hand_labels.resize(tracks.size());
+    hand_probs.resize(tracks.size());
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        hand_boxes[i] = tracks[i].roi;
+        hand_labels[i] = tracks[i].label;
+        hand_probs[i] = tracks[i].prob;
     }
 
+    landmark.detect(rgb, hand_boxes, hands);
+
+    objects.clear();
+    for (size_t i = 0; i < hands.size(); i++)
+    {
+        const float confidence = HandTracker::keypoint_confidence(hands[i], hand_boxes[i]);
+        if (confidence < tracker.confidence_threshold())
+            continue;
+
+        Object obj;
+        obj.rect = hand_boxes[i];
+        obj.label = hands[i].score > 0.3 ? 0 : 1;
+        obj.prob = hand_probs[i];
+        obj.track_confidence = confidence;
+        for (int j = 0; j < 21; j++)
+            obj.pts[j] = hands[i].pts[j];
+
+        objects.push_back(obj);
+    }
+
+    tracker.update(hand_boxes, hands, hand_labels, hand_probs, false, rgb.cols, rgb.rows);
+
     return 0;
 }
 
-int Yolox::draw(cv::Mat& rgb, const std::vector<Object>& objects)
+void Yolox::set_tracking(float min_confidence, int redetect_interval)
+{
+    tracker.set_params(min_confidence, redetect_interval);
+}
+
+void Yolox::set_num_threads(int _num_threads)
 {
+    num_threads = _num_threads;
+    landmark.set_num_threads(num_threads);
+}
+
+void Yolox::get_arena_usage(size_t& current_bytes, size_t& peak_bytes) const
+{
+    landmark.get_arena_usage(current_bytes, peak_bytes);
+
+    current_bytes += blob_allocator.current_bytes() + workspace_allocator.current_bytes();
+    peak_bytes += blob_allocator.peak_bytes() + workspace_allocator.peak_bytes();
+}
+
+int Yolox::draw(cv::Mat& rgb, const std::vector<Object>& objects, Overlay& overlay)
+{
+    PROFILE_STAGE(STAGE_DRAW);
+
     static const char* class_names[] = {
             "left_hand",
             "right_hand"
@@ -436,76 +618,39 @@ int Yolox::draw(cv::Mat& rgb, const std::vector<Object>& objects)
         {139, 125,  96}
     };
 
-    int color_index = 0;
+    static const unsigned char black[3] = {0, 0, 0};
+    static const unsigned char white[3] = {255, 255, 255};
+
+    overlay.begin(rgb);
 
     for (size_t i = 0; i < objects.size(); i++)
     {
         const Object& obj = objects[i];
 
-        const unsigned char* color = colors[color_index % 19];
-        color_index++;
-
-        cv::Scalar cc(color[0], color[1], color[2]);
+        const unsigned char* color = colors[i % 19];
 
-        cv::rectangle(rgb,obj.rect, cc, 2);
+        overlay.rectangle(obj.rect, color, 2);
 
         char text[256];
         sprintf(text, "%s %.1f%%", class_names[obj.label], obj.prob * 100);
 
-        int baseLine = 0;
-        cv::Size label_size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
+        cv::Size label_size = overlay.text_size(text);
 
         int x = obj.rect.x;
-        int y = obj.rect.y - label_size.height - baseLine;
+        int y = obj.rect.y - label_size.height;
         if (y < 0)
             y = 0;
         if (x + label_size.width > rgb.cols)
             x = rgb.cols - label_size.width;
 
-        cv::rectangle(rgb, cv::Rect(cv::Point(x, y), cv::Size(label_size.width, label_size.height + baseLine)), cc, -1);
-
-        cv::Scalar textcc = (color[0] + color[1] + color[2] >= 381) ? cv::Scalar(0, 0, 0) : cv::Scalar(255, 255, 255);
+        overlay.fill(cv::Rect(x, y, label_size.width, label_size.height), color);
 
-        cv::putText(rgb, text, cv::Point(x, y + label_size.height), cv::FONT_HERSHEY_SIMPLEX, 0.5, textcc, 1);
-        //draw hand pose
-        {
-            cv::Scalar color1(10, 215, 255);
-            cv::Scalar color2(255, 115, 55);
-            cv::Scalar color3(5, 255, 55);
-            cv::Scalar color4(25, 15, 255);
-            cv::Scalar color5(225, 15, 55);
-            for(size_t j = 0; j < 21; j++)
-            {
-                cv::circle(rgb, obj.pts[j],4,cv::Scalar(255,0,0),-1);
-                if (j < 4)
-                {
-                    cv::line(rgb, obj.pts[j], obj.pts[j+1], color1, 2, 8);
-                }
-                if (j < 8 && j > 4)
-                {
-                    cv::line(rgb, obj.pts[j], obj.pts[j+1], color2, 2, 8);
-                }
-                if (j < 12 && j > 8)
-                {
-                    cv::line(rgb, obj.pts[j], obj.pts[j+1], color3, 2, 8);
-                }
-                if (j < 16 && j > 12)
-                {
-                    cv::line(rgb, obj.pts[j], obj.pts[j+1], color4, 2, 8);
-                }
-                if (j < 20 && j > 16)
-                {
-                    cv::line(rgb, obj.pts[j], obj.pts[j+1], color5, 2, 8);
-                }
-            }
-            cv::line(rgb, obj.pts[0], obj.pts[5], color2, 2, 8);
-            cv::line(rgb, obj.pts[0], obj.pts[9], color3, 2, 8);
-            cv::line(rgb, obj.pts[0], obj.pts[13], color4, 2, 8);
-            cv::line(rgb, obj.pts[0], obj.pts[17], color5, 2, 8);
-        }
+        overlay.text(x, y, text, color[0] + color[1] + color[2] >= 381 ? black : white);
 
+        overlay.hand(obj.pts);
     }
-    
-    
+
+    overlay.end();
+
     return 0;
 }
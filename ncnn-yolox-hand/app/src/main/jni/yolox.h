@@ -15,37 +15,138 @@
 #ifndef YOLOX_H
 #define YOLOX_H
 
+#include <memory>
+
 #include <opencv2/core/core.hpp>
 #include <net.h>
+#include "arena.h"
 #include "landmark.h"
+#include "letterbox.h"
+#include "modelfile.h"
+#include "nms.h"
+#include "overlay.h"
+#include "tracker.h"
 
 struct Object
 {
     cv::Rect_<float> rect;
     int label;
+    // detector score, carried over while the hand is tracked
     float prob;
+    // keypoint confidence from 0 to 1, see HandTracker::keypoint_confidence, 0 for boxes without landmarks
+    float track_confidence;
     cv::Point2f pts[21];
    
 };
 
+// detect() and track() results in storage owned by the caller, nothing in it is ever allocated
+// keep one per stream and pass it every frame
+struct HandResult
+{
+    HandResult() : count(0) {}
+
+    enum { max_hands = 8 };
+
+    // the first count entries are the hands of this frame
+    Object objects[max_hands];
+    int count;
+};
+
+struct GridAndStride
+{
+    int grid0;
+    int grid1;
+    int stride;
+};
 
+// param and weights of the detector and the landmark net, read only once loaded
+// any number of Yolox sessions on any threads can share one
+class YoloxModel
+{
+public:
+    int load(const char* modeltype, int target_size, const float* mean_vals, const float* norm_vals, bool use_gpu = false);
+
+#if __ANDROID_API__ >= 9
+    int load(AAssetManager* mgr, const char* modeltype, int target_size, const float* mean_vals, const float* norm_vals, bool use_gpu = false);
+#endif // __ANDROID_API__ >= 9
+
+private:
+    // weights of the net point into this mapping, declared first so it outlives the net
+    MappedFile model_file;
+
+public:
+    ncnn::Net yolox;
+    std::shared_ptr<LandmarkModel> landmark;
+    int target_size;
+    float mean_vals[3];
+    float norm_vals[3];
+};
+
+// one stream: extractors, arena allocators, input and proposal scratch and the tracker,
+// used from one thread at a time, sessions sharing a model run in parallel
 class Yolox
 {
 public:
     Yolox();
 
+    // loads a model of its own
     int load(const char* modeltype, int target_size, const float* mean_vals, const float* norm_vals, bool use_gpu = false);
 
+#if __ANDROID_API__ >= 9
     int load(AAssetManager* mgr, const char* modeltype, int target_size, const float* mean_vals, const float* norm_vals, bool use_gpu = false);
+#endif // __ANDROID_API__ >= 9
+
+    // run on a model shared with other sessions
+    void set_model(const std::shared_ptr<const YoloxModel>& model);
 
+    // objects is resized in place and keeps its capacity, reuse it across frames
     int detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold = 0.45f, float nms_threshold = 0.65f);
 
-    int draw(cv::Mat& rgb, const std::vector<Object>& objects);
+    // boxes only, sampled straight from the camera nv21 frame
+    // roi and rotate_type as in NdkCameraWindow, boxes are in rotated roi coordinates
+    int detect(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, std::vector<Object>& objects, float prob_threshold = 0.45f, float nms_threshold = 0.65f);
+
+    // hand landmarks and handedness for the boxes in objects
+    int detect_landmarks(const cv::Mat& rgb, std::vector<Object>& objects);
+
+    // detect() when the tracker lost a hand or is due for a redetect, track_landmarks() otherwise
+    int track(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold = 0.45f, float nms_threshold = 0.65f);
+
+    // detect() and track() into a HandResult, hands past HandResult::max_hands are left out
+    // no heap allocation in the session once the first frames grew its scratch, only inside ncnn::Extractor
+    int detect(const cv::Mat& rgb, HandResult& result, float prob_threshold = 0.45f, float nms_threshold = 0.65f);
+    int track(const cv::Mat& rgb, HandResult& result, float prob_threshold = 0.45f, float nms_threshold = 0.65f);
+
+    // true when the next frame needs the box detector
+    bool need_detect() const;
+
+    // landmarks only, on the rois predicted from the previous frame keypoints
+    // prob keeps the detector score of the hand, lost hands are left out
+    int track_landmarks(const cv::Mat& rgb, std::vector<Object>& objects);
+
+    // see HandTracker::set_params, redetect_interval 0 runs the detector on every frame
+    void set_tracking(float min_confidence, int redetect_interval);
+
+    // detector and landmark threads, overrides the big core count picked at load
+    void set_num_threads(int num_threads);
+
+    // optional, run after load(): one blank target_size x target_size frame through the detector
+    // and blank hands through the landmark net, returns the time spent in ms
+    double warmup();
+
+    // bytes held by the detector and landmark arenas right now and at most
+    void get_arena_usage(size_t& current_bytes, size_t& peak_bytes) const;
+
+    static int draw(cv::Mat& rgb, const std::vector<Object>& objects, Overlay& overlay);
 
 private:
+    int detect_boxes(int img_w, int img_h, float scale, std::vector<Object>& objects, float prob_threshold, float nms_threshold);
 
-    ncnn::Net yolox;
+private:
+    std::shared_ptr<const YoloxModel> model;
     LandmarkDetect landmark;
+    int num_threads;
+    // copied from the model
     int target_size;
     float mean_vals[3];
     float norm_vals[3];
@@ -54,8 +155,24 @@ private:
     int in_w;
     int in_h;
 
-    ncnn::UnlockedPoolAllocator blob_pool_allocator;
-    ncnn::PoolAllocator workspace_pool_allocator;
+    // reused across frames, in_w x in_h is the shape grid_strides was built for
+    Letterbox letterbox;
+    ncnn::Mat in_pad;
+    std::vector<GridAndStride> grid_strides;
+    std::vector<Object> proposals;
+    std::vector<int> picked;
+    BoxNms nms;
+    std::vector<cv::Rect> hand_boxes;
+    std::vector<HandLandmarks> hands;
+    std::vector<int> hand_labels;
+    std::vector<float> hand_probs;
+    // objects of the HandResult overloads
+    std::vector<Object> result_objects;
+    HandTracker tracker;
+
+    // detector net only, the landmark session has its own per hand slot
+    ArenaAllocator blob_allocator;
+    LockedArenaAllocator workspace_allocator;
 };
 
 #endif // NANODET_H
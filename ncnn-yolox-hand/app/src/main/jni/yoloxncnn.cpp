@@ -20,6 +20,9 @@
 
 #include <jni.h>
 
+#include <algorithm>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -28,7 +31,12 @@
 
 #include "yolox.h"
 
+#include "hotswap.h"
 #include "ndkcamera.h"
+#include "nv21.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "tracer.h"
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -110,35 +118,140 @@ static int draw_fps(cv::Mat& rgb)
     return 0;
 }
 
-static Yolox* g_yolox = 0;
-static ncnn::Mutex lock;
+// the detector in use, reloads are built off the frame loop and swapped in when ready
+static HotSwap<Yolox> g_yolox;
+
+// one camera frame on its way through the pipeline
+struct CameraFrame
+{
+    cv::Mat rgb;
+    int render_rotate_type;
+    // the camera roi as a compact nv21 image, the detector samples it directly and infer() converts it to rgb
+    std::vector<unsigned char> nv21;
+    int nv21_width;
+    int nv21_height;
+    int rotate_type;
+    std::vector<Object> objects;
+    bool has_model;
+    // camera frame number, tags the trace events of later stages
+    int frame_number;
+};
 
 class MyNdkCamera : public NdkCameraWindow
 {
 public:
-    virtual void on_image_render(cv::Mat& rgb) const;
+    MyNdkCamera();
+    ~MyNdkCamera();
+
+    // inference and render threads, started around open and close
+    void start();
+    void stop();
+
+    virtual void on_image_nv21(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, int render_rotate_type) const;
+
+private:
+    void infer(CameraFrame& frame) const;
+    void render_frame(CameraFrame& frame) const;
+
+private:
+    mutable FramePipeline<CameraFrame> pipeline;
+    // only used from the render thread
+    mutable Overlay overlay;
 };
 
-void MyNdkCamera::on_image_render(cv::Mat& rgb) const
+MyNdkCamera::MyNdkCamera()
+{
+}
+
+MyNdkCamera::~MyNdkCamera()
+{
+    stop();
+}
+
+void MyNdkCamera::start()
+{
+    pipeline.start(std::bind(&MyNdkCamera::infer, this, std::placeholders::_1), std::bind(&MyNdkCamera::render_frame, this, std::placeholders::_1));
+}
+
+void MyNdkCamera::stop()
+{
+    pipeline.stop();
+}
+
+void MyNdkCamera::on_image_nv21(const unsigned char* nv21, int nv21_width, int nv21_height, int roi_x, int roi_y, int roi_w, int roi_h, int rotate_type, int render_rotate_type) const
 {
-    // nanodet
+    // dropped when every frame is still in flight, the camera thread only copies the roi of accepted frames
+    pipeline.capture([&](CameraFrame& frame)
     {
-        ncnn::MutexLockGuard g(lock);
+        // the camera reuses its nv21 buffer, copy the roi into the pooled frame
+        frame.nv21.resize(roi_w * roi_h * 3 / 2);
+        nv21_roi_copy(nv21, nv21_width, nv21_height, roi_x, roi_y, roi_w, roi_h, frame.nv21.data());
+        frame.nv21_width = roi_w;
+        frame.nv21_height = roi_h;
+        frame.rotate_type = rotate_type;
+        frame.render_rotate_type = render_rotate_type;
+
+        frame.frame_number = Tracer::frame();
+    });
+}
 
-        if (g_yolox)
-        {
-            std::vector<Object> objects;
-            g_yolox->detect(rgb, objects);
+void MyNdkCamera::infer(CameraFrame& frame) const
+{
+    TRACE_FRAME(frame.frame_number);
+    TRACE_SCOPE("infer");
 
-            g_yolox->draw(rgb, objects);
+    // every frame in the pipeline is rendered, crop, rotate and convert it once here into its reused rgb buffer
+    const int w = frame.rotate_type <= 4 ? frame.nv21_width : frame.nv21_height;
+    const int h = frame.rotate_type <= 4 ? frame.nv21_height : frame.nv21_width;
+    frame.rgb.create(h, w, CV_8UC3);
+    {
+        PROFILE_STAGE(STAGE_CAMERA);
+        nv21_roi_rotate_to_rgb(frame.nv21.data(), frame.nv21_width, frame.nv21_height, 0, 0, frame.nv21_width, frame.nv21_height, frame.rotate_type, frame.rgb.data, (int)frame.rgb.step[0]);
+    }
+
+    // hold on to this frame's instance, a reload may publish a new one meanwhile
+    std::shared_ptr<Yolox> detector = g_yolox.get();
+
+    frame.has_model = detector != 0;
+    if (detector)
+    {
+        if (detector->need_detect())
+        {
+            // boxes straight from the nv21 roi, only the landmark crops read the rgb frame
+            int ret = detector->detect(frame.nv21.data(), frame.nv21_width, frame.nv21_height, 0, 0, frame.nv21_width, frame.nv21_height, frame.rotate_type, frame.objects);
+            if (ret == 0)
+            {
+                detector->detect_landmarks(frame.rgb, frame.objects);
+            }
         }
         else
         {
-            draw_unsupported(rgb);
+            detector->track_landmarks(frame.rgb, frame.objects);
         }
     }
+    else
+    {
+        frame.objects.clear();
+    }
+}
+
+void MyNdkCamera::render_frame(CameraFrame& frame) const
+{
+    TRACE_FRAME(frame.frame_number);
+    TRACE_SCOPE("render");
 
-    draw_fps(rgb);
+    if (frame.has_model)
+    {
+        Yolox::draw(frame.rgb, frame.objects, overlay);
+    }
+    else
+    {
+        draw_unsupported(frame.rgb);
+    }
+
+    draw_fps(frame.rgb);
+
+    render(frame.rgb, frame.render_rotate_type);
 }
 
 static MyNdkCamera* g_camera = 0;
@@ -158,15 +271,13 @@ JNIEXPORT void JNI_OnUnload(JavaVM* vm, void* reserved)
 {
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "JNI_OnUnload");
 
-    {
-        ncnn::MutexLockGuard g(lock);
-
-        delete g_yolox;
-        g_yolox = 0;
-    }
-
     delete g_camera;
     g_camera = 0;
+
+    // the last instance is destroyed on the loader thread, wait for it before the library goes away
+    g_yolox.wait_idle();
+    g_yolox.publish(std::shared_ptr<Yolox>());
+    g_yolox.wait_idle();
 }
 
 // public native boolean loadModel(AssetManager mgr, int modelid, int cpugpu);
@@ -209,22 +320,35 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_ncnnyolox_NcnnYolox_loadModel(JNIEnv
     int target_size = target_sizes[(int)modelid];
     bool use_gpu = (int)cpugpu == 1;
 
-    // reload
+    // reload in the background, frames keep using the current instance until the new one is ready
+    if (use_gpu && ncnn::get_gpu_count() == 0)
     {
-        ncnn::MutexLockGuard g(lock);
-
-        if (use_gpu && ncnn::get_gpu_count() == 0)
-        {
-            // no gpu
-            delete g_yolox;
-            g_yolox = 0;
-        }
-        else
-        {
-            if (!g_yolox)
-                g_yolox = new Yolox;
-            g_yolox->load(mgr, modeltype, target_size, mean_vals[(int)modelid], norm_vals[(int)modelid], use_gpu);
-        }
+        // no gpu
+        g_yolox.load_async([](std::shared_ptr<Yolox>&) { return 0; });
+    }
+    else
+    {
+        std::vector<float> mean(mean_vals[(int)modelid], mean_vals[(int)modelid] + 3);
+        std::vector<float> norm(norm_vals[(int)modelid], norm_vals[(int)modelid] + 3);
+
+        // the asset manager belongs to the application and outlives the load
+        g_yolox.load_async([=](std::shared_ptr<Yolox>& instance) {
+            std::shared_ptr<Yolox> detector = std::make_shared<Yolox>();
+            int ret = detector->load(mgr, modeltype, target_size, mean.data(), norm.data(), use_gpu);
+            if (ret != 0)
+            {
+                // frames keep running on the instance already published
+                __android_log_print(ANDROID_LOG_WARN, "ncnn", "load %s failed %d", modeltype, ret);
+                return ret;
+            }
+
+            // the first camera frame should not pay for pipeline creation and pool growth
+            double warmup_time = detector->warmup();
+            __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "warmup %s %.2fms", modeltype, warmup_time);
+
+            instance = detector;
+            return 0;
+        });
     }
 
     return JNI_TRUE;
@@ -238,6 +362,7 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_ncnnyolox_NcnnYolox_openCamera(JNIEn
 
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "openCamera %d", facing);
 
+    g_camera->start();
     g_camera->open((int)facing);
 
     return JNI_TRUE;
@@ -249,6 +374,7 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_ncnnyolox_NcnnYolox_closeCamera(JNIE
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "closeCamera");
 
     g_camera->close();
+    g_camera->stop();
 
     return JNI_TRUE;
 }
@@ -265,4 +391,46 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_ncnnyolox_NcnnYolox_setOutputWindow(
     return JNI_TRUE;
 }
 
+// public native float[] getStageLatency();
+// p50, p95 and p99 in ms for each stage: camera preprocess inference decode nms landmark draw blit
+JNIEXPORT jfloatArray JNICALL Java_com_tencent_ncnnyolox_NcnnYolox_getStageLatency(JNIEnv* env, jobject thiz)
+{
+    float latency[STAGE_COUNT * 3];
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        StageProfiler::query(i, latency[i * 3], latency[i * 3 + 1], latency[i * 3 + 2]);
+    }
+
+    jfloatArray result = env->NewFloatArray(STAGE_COUNT * 3);
+    if (!result)
+        return 0;
+
+    env->SetFloatArrayRegion(result, 0, STAGE_COUNT * 3, latency);
+
+    return result;
+}
+
+// public native boolean startTrace();
+JNIEXPORT jboolean JNICALL Java_com_tencent_ncnnyolox_NcnnYolox_startTrace(JNIEnv* env, jobject thiz)
+{
+    Tracer::start();
+
+    return JNI_TRUE;
+}
+
+// public native boolean dumpTrace(String path);
+// stops tracing and writes chrome trace json to path
+JNIEXPORT jboolean JNICALL Java_com_tencent_ncnnyolox_NcnnYolox_dumpTrace(JNIEnv* env, jobject thiz, jstring path)
+{
+    const char* trace_path = env->GetStringUTFChars(path, 0);
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "dumpTrace %s", trace_path);
+
+    int ret = Tracer::dump(trace_path);
+
+    env->ReleaseStringUTFChars(path, trace_path);
+
+    return ret == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
 }